@@ -27,6 +27,9 @@
 #include "msm_vidc_qcm6490.h"
 #include "msm_vidc_iris3.h"
 #include "msm_vidc_iris2.h"
+#ifdef CONFIG_MSM_VIDC_SIM
+#include "msm_vidc_sim.h"
+#endif
 
 #define CAP_TO_8BIT_QP(a) {          \
 	if ((a) < MIN_QP_8BIT)                 \
@@ -214,6 +217,13 @@ static const struct msm_vidc_compat_handle compat_handle[] = {
 		.init_platform              = msm_vidc_init_platform_qcs8300,
 		.init_iris                  = msm_vidc_init_iris3,
 	},
+#ifdef CONFIG_MSM_VIDC_SIM
+	{
+		.compat                     = "qcom,qcm6490-iris-vpu-sim",
+		.init_platform              = msm_vidc_init_platform_qcm6490,
+		.init_iris                  = msm_vidc_init_sim,
+	},
+#endif
 };
 
 static int msm_vidc_init_ops(struct msm_vidc_core *core)
@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (c) 2020-2021, The Linux Foundation. All rights reserved.
+ * Copyright (c) 2023-2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ */
+
+#ifndef _MSM_VIDC_SIM_H_
+#define _MSM_VIDC_SIM_H_
+
+#include "msm_vidc_core.h"
+
+int msm_vidc_init_sim(struct msm_vidc_core *core);
+
+#endif // _MSM_VIDC_SIM_H_
@@ -0,0 +1,878 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (c) 2020-2021, The Linux Foundation. All rights reserved.
+ * Copyright (c) 2023-2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ */
+
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+
+#include "msm_vidc_sim.h"
+#include "msm_vidc_iris2.h"
+#include "msm_vidc_core.h"
+#include "msm_vidc_debug.h"
+#include "msm_vidc_internal.h"
+#include "msm_vidc_platform.h"
+#include "hfi_command.h"
+#include "hfi_property.h"
+#include "hfi_packet.h"
+#include "venus_hfi.h"
+#include "venus_hfi_queue.h"
+
+/*
+ * Software model of the video firmware. It consumes the command queue
+ * set up by venus_hfi_queue_init() and posts responses to the message
+ * queue, so that the whole v4l2 -> vb2 -> hfi -> response path can be
+ * exercised without video hardware. Hardware resources (clocks, gdsc,
+ * irq) are stubbed out, memory still comes from the platform device.
+ *
+ * The model runs on an ordered workqueue and therefore needs no locking
+ * of its own. Responses are posted in order, buffer done responses after
+ * msm_vidc_sim_latency_us.
+ */
+
+#define SIM_MAX_PROPS		16
+#define SIM_MAX_OUTPUTS		64
+#define SIM_FW_VERSION		"video-firmware.sim"
+#define SIM_INTR_STATUS		0x1
+#define SIM_MSGQ_RETRY_US	1000
+
+struct msm_vidc_sim_prop {
+	u32                                    type;
+	u32                                    port;
+	u32                                    payload_info;
+	u32                                    payload_size;
+	u32                                    payload[2];
+};
+
+struct msm_vidc_sim_session {
+	struct list_head                       list;
+	u32                                    session_id;
+	bool                                   psc_sent;
+	bool                                   drain_pending;
+	u32                                    psc_count;
+	u32                                    psc_types[SIM_MAX_PROPS];
+	u32                                    prop_count;
+	struct msm_vidc_sim_prop               props[SIM_MAX_PROPS];
+	u32                                    out_port;
+	u32                                    out_head;
+	u32                                    out_count;
+	struct hfi_buffer                      outputs[SIM_MAX_OUTPUTS];
+};
+
+struct msm_vidc_sim_response {
+	struct list_head                       list;
+	ktime_t                                due;
+	u8                                     data[];
+};
+
+struct msm_vidc_sim {
+	struct msm_vidc_core                  *core;
+	struct workqueue_struct               *fw_workq;
+	struct workqueue_struct               *irq_workq;
+	struct work_struct                     cmd_work;
+	struct work_struct                     done_work;
+	struct work_struct                     irq_work;
+	struct hrtimer                         done_timer;
+	struct list_head                       sessions;
+	struct list_head                       responses;
+	atomic_t                               intr_status;
+	u32                                    header_id;
+	u8                                    *cmd_pkt;
+	u8                                    *rsp_pkt;
+};
+
+static int __sim_read_cmdq(struct msm_vidc_sim *sim)
+{
+	struct msm_vidc_iface_q_info *q_info;
+	struct hfi_queue_header *queue;
+	u32 q_size, read_idx, write_idx, size_in_words, new_read_idx;
+	u32 *read_ptr;
+
+	q_info = &sim->core->iface_queues[VIDC_IFACEQ_CMDQ_IDX];
+	queue = (struct hfi_queue_header *)q_info->q_hdr;
+	if (!queue || !q_info->q_array.align_virtual_addr)
+		return -ENODATA;
+
+	/* make sure packet data is read after the write index */
+	mb();
+	read_idx = queue->qhdr_read_idx;
+	write_idx = queue->qhdr_write_idx;
+	if (read_idx == write_idx)
+		return -ENODATA;
+
+	q_size = q_info->q_array.mem_size >> 2;
+	read_ptr = (u32 *)q_info->q_array.align_virtual_addr + read_idx;
+	size_in_words = read_idx < q_size ? (*read_ptr >> 2) : 0;
+	if (!size_in_words ||
+	    (size_in_words << 2) > VIDC_IFACEQ_VAR_HUGE_PKT_SIZE) {
+		d_vpr_e("%s: bad cmd packet, read_idx %u size %u\n",
+			__func__, read_idx, size_in_words << 2);
+		queue->qhdr_read_idx = write_idx;
+		mb();
+		return -EINVAL;
+	}
+
+	new_read_idx = read_idx + size_in_words;
+	if (new_read_idx < q_size) {
+		memcpy(sim->cmd_pkt, read_ptr, size_in_words << 2);
+	} else {
+		new_read_idx -= q_size;
+		memcpy(sim->cmd_pkt, read_ptr,
+			(size_in_words - new_read_idx) << 2);
+		memcpy(sim->cmd_pkt + ((size_in_words - new_read_idx) << 2),
+			q_info->q_array.align_virtual_addr, new_read_idx << 2);
+	}
+
+	/* make sure packet is copied before releasing the ring space */
+	mb();
+	queue->qhdr_read_idx = new_read_idx;
+	mb();
+
+	return 0;
+}
+
+static int __sim_write_msgq(struct msm_vidc_sim *sim, u8 *packet)
+{
+	struct msm_vidc_iface_q_info *q_info;
+	struct hfi_queue_header *queue;
+	u32 q_size, read_idx, write_idx, size_in_words, new_write_idx;
+	u32 empty_space;
+	u32 *write_ptr;
+
+	q_info = &sim->core->iface_queues[VIDC_IFACEQ_MSGQ_IDX];
+	queue = (struct hfi_queue_header *)q_info->q_hdr;
+	if (!queue || !q_info->q_array.align_virtual_addr)
+		return -ENODATA;
+
+	q_size = q_info->q_array.mem_size >> 2;
+	size_in_words = (*(u32 *)packet) >> 2;
+	read_idx = queue->qhdr_read_idx;
+	write_idx = queue->qhdr_write_idx;
+
+	empty_space = (write_idx >= read_idx) ?
+		(q_size - (write_idx - read_idx)) : (read_idx - write_idx);
+	if (empty_space <= size_in_words)
+		return -ENOSPC;
+
+	write_ptr = (u32 *)q_info->q_array.align_virtual_addr + write_idx;
+	new_write_idx = write_idx + size_in_words;
+	if (new_write_idx < q_size) {
+		memcpy(write_ptr, packet, size_in_words << 2);
+	} else {
+		new_write_idx -= q_size;
+		memcpy(write_ptr, packet, (size_in_words - new_write_idx) << 2);
+		memcpy(q_info->q_array.align_virtual_addr,
+			packet + ((size_in_words - new_write_idx) << 2),
+			new_write_idx << 2);
+	}
+
+	/* make sure packet is written before updating the write index */
+	mb();
+	queue->qhdr_write_idx = new_write_idx;
+	mb();
+
+	/* host asks for an interrupt only when it is not polling */
+	if (queue->qhdr_rx_req) {
+		atomic_or(SIM_INTR_STATUS, &sim->intr_status);
+		queue_work(sim->irq_workq, &sim->irq_work);
+	}
+
+	return 0;
+}
+
+static void __sim_flush_responses(struct msm_vidc_sim *sim)
+{
+	struct msm_vidc_sim_response *rsp, *dummy;
+	ktime_t now = ktime_get();
+
+	list_for_each_entry_safe(rsp, dummy, &sim->responses, list) {
+		if (ktime_after(rsp->due, now)) {
+			hrtimer_start(&sim->done_timer, rsp->due, HRTIMER_MODE_ABS);
+			return;
+		}
+		if (__sim_write_msgq(sim, rsp->data)) {
+			/* msgq full, retry once the host drained it */
+			hrtimer_start(&sim->done_timer,
+				us_to_ktime(SIM_MSGQ_RETRY_US), HRTIMER_MODE_REL);
+			return;
+		}
+		list_del(&rsp->list);
+		kfree(rsp);
+	}
+}
+
+/* queue sim->rsp_pkt to be posted to the msgq after delay_us */
+static int __sim_post(struct msm_vidc_sim *sim, u32 delay_us)
+{
+	struct hfi_header *hdr = (struct hfi_header *)sim->rsp_pkt;
+	struct msm_vidc_sim_response *rsp, *tail;
+	ktime_t due;
+
+	due = ktime_add_us(ktime_get(), delay_us);
+	if (!list_empty(&sim->responses)) {
+		/* keep responses in order of submission */
+		tail = list_last_entry(&sim->responses,
+				       struct msm_vidc_sim_response, list);
+		if (ktime_before(due, tail->due))
+			due = tail->due;
+	} else if (!delay_us && !__sim_write_msgq(sim, sim->rsp_pkt)) {
+		return 0;
+	}
+
+	rsp = kzalloc(sizeof(*rsp) + hdr->size, GFP_KERNEL);
+	if (!rsp) {
+		d_vpr_e("%s: allocation failed\n", __func__);
+		return -ENOMEM;
+	}
+	rsp->due = due;
+	memcpy(rsp->data, sim->rsp_pkt, hdr->size);
+	list_add_tail(&rsp->list, &sim->responses);
+
+	if (list_is_first(&rsp->list, &sim->responses))
+		hrtimer_start(&sim->done_timer, due, HRTIMER_MODE_ABS);
+
+	return 0;
+}
+
+static int __sim_create_header(struct msm_vidc_sim *sim, u32 session_id)
+{
+	return hfi_create_header(sim->rsp_pkt, VIDC_IFACEQ_VAR_HUGE_PKT_SIZE,
+				 session_id, sim->header_id++);
+}
+
+static int __sim_ack(struct msm_vidc_sim *sim, u32 session_id,
+	struct hfi_packet *pkt, u32 delay_us)
+{
+	int rc;
+
+	rc = __sim_create_header(sim, session_id);
+	if (rc)
+		return rc;
+
+	rc = hfi_create_packet(sim->rsp_pkt, VIDC_IFACEQ_VAR_HUGE_PKT_SIZE,
+			       pkt->type, HFI_FW_FLAGS_SUCCESS, HFI_PAYLOAD_NONE,
+			       pkt->port, pkt->packet_id, NULL, 0);
+	if (rc)
+		return rc;
+
+	return __sim_post(sim, delay_us);
+}
+
+static int __sim_add_buffer(struct msm_vidc_sim *sim, u32 port,
+	u32 packet_id, struct hfi_buffer *buffer)
+{
+	return hfi_create_packet(sim->rsp_pkt, VIDC_IFACEQ_VAR_HUGE_PKT_SIZE,
+				 HFI_CMD_BUFFER, HFI_FW_FLAGS_SUCCESS,
+				 HFI_PAYLOAD_STRUCTURE, port, packet_id,
+				 buffer, sizeof(*buffer));
+}
+
+static int __sim_buffer_done(struct msm_vidc_sim *sim, u32 session_id,
+	u32 port, u32 packet_id, struct hfi_buffer *buffer, u32 delay_us)
+{
+	int rc;
+
+	rc = __sim_create_header(sim, session_id);
+	if (rc)
+		return rc;
+
+	rc = __sim_add_buffer(sim, port, packet_id, buffer);
+	if (rc)
+		return rc;
+
+	return __sim_post(sim, delay_us);
+}
+
+static struct msm_vidc_sim_session *__sim_get_session(
+	struct msm_vidc_sim *sim, u32 session_id)
+{
+	struct msm_vidc_sim_session *session;
+
+	list_for_each_entry(session, &sim->sessions, list) {
+		if (session->session_id == session_id)
+			return session;
+	}
+
+	return NULL;
+}
+
+static void __sim_reset(struct msm_vidc_sim *sim)
+{
+	struct msm_vidc_sim_session *session, *dummy_session;
+	struct msm_vidc_sim_response *rsp, *dummy_rsp;
+
+	hrtimer_cancel(&sim->done_timer);
+
+	list_for_each_entry_safe(rsp, dummy_rsp, &sim->responses, list) {
+		list_del(&rsp->list);
+		kfree(rsp);
+	}
+
+	list_for_each_entry_safe(session, dummy_session, &sim->sessions, list) {
+		list_del(&session->list);
+		kfree(session);
+	}
+
+	atomic_set(&sim->intr_status, 0);
+	sim->header_id = 0;
+}
+
+static void __sim_cache_property(struct msm_vidc_sim_session *session,
+	struct hfi_packet *pkt)
+{
+	struct msm_vidc_sim_prop *prop = NULL;
+	u32 payload_size, i;
+
+	payload_size = pkt->size - sizeof(struct hfi_packet);
+	if (!payload_size || payload_size > sizeof(prop->payload))
+		return;
+
+	for (i = 0; i < session->prop_count; i++) {
+		if (session->props[i].type == pkt->type &&
+		    session->props[i].port == pkt->port) {
+			prop = &session->props[i];
+			break;
+		}
+	}
+	if (!prop) {
+		if (session->prop_count >= SIM_MAX_PROPS)
+			return;
+		prop = &session->props[session->prop_count++];
+	}
+
+	prop->type = pkt->type;
+	prop->port = pkt->port;
+	prop->payload_info = pkt->payload_info;
+	prop->payload_size = payload_size;
+	memcpy(prop->payload, (u8 *)pkt + sizeof(struct hfi_packet),
+		payload_size);
+}
+
+static void __sim_set_codec(struct msm_vidc_sim_session *session,
+	struct hfi_packet *pkt)
+{
+	u32 codec;
+
+	if (pkt->size < sizeof(struct hfi_packet) + sizeof(u32))
+		return;
+
+	codec = *(u32 *)((u8 *)pkt + sizeof(struct hfi_packet));
+	/* output port is the raw port for decoder, bitstream for encoder */
+	if (codec == HFI_CODEC_ENCODE_AVC || codec == HFI_CODEC_ENCODE_HEVC)
+		session->out_port = HFI_PORT_BITSTREAM;
+	else
+		session->out_port = HFI_PORT_RAW;
+}
+
+static void __sim_subscribe(struct msm_vidc_sim_session *session,
+	struct hfi_packet *pkt)
+{
+	u32 *payload = (u32 *)((u8 *)pkt + sizeof(struct hfi_packet));
+	u32 count, i;
+
+	count = (pkt->size - sizeof(struct hfi_packet)) / sizeof(u32);
+	if (!count || payload[0] != HFI_MODE_PORT_SETTINGS_CHANGE)
+		return;
+
+	session->psc_count = 0;
+	for (i = 1; i < count && session->psc_count < SIM_MAX_PROPS; i++)
+		session->psc_types[session->psc_count++] = payload[i];
+}
+
+/* input port settings change, reports back the subscribed properties */
+static int __sim_post_psc(struct msm_vidc_sim *sim,
+	struct msm_vidc_sim_session *session, u32 packet_id)
+{
+	struct msm_vidc_sim_prop *prop;
+	u32 i, j;
+	int rc;
+
+	rc = __sim_create_header(sim, session->session_id);
+	if (rc)
+		return rc;
+
+	for (i = 0; i < session->psc_count; i++) {
+		for (j = 0; j < session->prop_count; j++) {
+			prop = &session->props[j];
+			if (prop->type != session->psc_types[i] ||
+			    prop->port != HFI_PORT_BITSTREAM)
+				continue;
+			rc = hfi_create_packet(sim->rsp_pkt,
+				VIDC_IFACEQ_VAR_HUGE_PKT_SIZE, prop->type,
+				HFI_FW_FLAGS_SUCCESS, prop->payload_info,
+				HFI_PORT_BITSTREAM, packet_id,
+				prop->payload, prop->payload_size);
+			if (rc)
+				return rc;
+		}
+	}
+
+	rc = hfi_create_packet(sim->rsp_pkt, VIDC_IFACEQ_VAR_HUGE_PKT_SIZE,
+			       HFI_CMD_SETTINGS_CHANGE, HFI_FW_FLAGS_SUCCESS,
+			       HFI_PAYLOAD_NONE, HFI_PORT_BITSTREAM, packet_id,
+			       NULL, 0);
+	if (rc)
+		return rc;
+
+	session->psc_sent = true;
+	return __sim_post(sim, msm_vidc_sim_latency_us);
+}
+
+static struct hfi_buffer *__sim_pop_output(struct msm_vidc_sim_session *session)
+{
+	struct hfi_buffer *buffer;
+
+	if (!session->out_count)
+		return NULL;
+
+	buffer = &session->outputs[session->out_head];
+	session->out_head = (session->out_head + 1) % SIM_MAX_OUTPUTS;
+	session->out_count--;
+
+	return buffer;
+}
+
+static int __sim_return_outputs(struct msm_vidc_sim *sim,
+	struct msm_vidc_sim_session *session, u32 packet_id)
+{
+	struct hfi_buffer *output;
+	int rc = 0;
+
+	while ((output = __sim_pop_output(session))) {
+		output->data_size = 0;
+		output->flags = 0;
+		rc = __sim_buffer_done(sim, session->session_id,
+			session->out_port, packet_id, output, 0);
+		if (rc)
+			return rc;
+	}
+
+	return rc;
+}
+
+static int __sim_drain_done(struct msm_vidc_sim *sim,
+	struct msm_vidc_sim_session *session, u32 packet_id)
+{
+	struct hfi_buffer *output;
+
+	output = __sim_pop_output(session);
+	if (!output) {
+		/* last flag goes out with the next output buffer */
+		session->drain_pending = true;
+		return 0;
+	}
+
+	session->drain_pending = false;
+	output->data_size = 0;
+	output->flags = HFI_BUF_FW_FLAG_LAST;
+
+	return __sim_buffer_done(sim, session->session_id, session->out_port,
+		packet_id, output, msm_vidc_sim_latency_us);
+}
+
+static int __sim_frame_done(struct msm_vidc_sim *sim,
+	struct msm_vidc_sim_session *session, u32 port, u32 packet_id,
+	struct hfi_buffer *input)
+{
+	struct hfi_buffer *output;
+	bool is_decode = port == HFI_PORT_BITSTREAM;
+	int rc;
+
+	if (is_decode && !session->psc_sent && session->psc_count) {
+		rc = __sim_post_psc(sim, session, packet_id);
+		if (rc)
+			return rc;
+	}
+
+	rc = __sim_create_header(sim, session->session_id);
+	if (rc)
+		return rc;
+
+	input->flags = 0;
+	rc = __sim_add_buffer(sim, port, packet_id, input);
+	if (rc)
+		return rc;
+
+	output = __sim_pop_output(session);
+	if (output) {
+		/* decoder fills the yuv buffer, encoder emits a fraction of the input */
+		output->data_size = is_decode ? output->buffer_size :
+			min_t(u32, output->buffer_size, max_t(u32, input->data_size >> 3, 1));
+		output->timestamp = input->timestamp;
+		output->flags = 0;
+		rc = __sim_add_buffer(sim, session->out_port, packet_id, output);
+		if (rc)
+			return rc;
+	}
+
+	return __sim_post(sim, msm_vidc_sim_latency_us);
+}
+
+static int __sim_handle_buffer(struct msm_vidc_sim *sim,
+	struct msm_vidc_sim_session *session, struct hfi_packet *pkt)
+{
+	struct hfi_buffer *buffer;
+	u32 idx;
+
+	if (pkt->size < sizeof(struct hfi_packet) + sizeof(struct hfi_buffer))
+		return -EINVAL;
+
+	buffer = (struct hfi_buffer *)((u8 *)pkt + sizeof(struct hfi_packet));
+
+	if (buffer->flags & HFI_BUF_HOST_FLAG_RELEASE) {
+		buffer->flags = HFI_BUF_FW_FLAG_RELEASE_DONE;
+		return __sim_buffer_done(sim, session->session_id, pkt->port,
+			pkt->packet_id, buffer, 0);
+	}
+
+	switch (buffer->type) {
+	case HFI_BUFFER_METADATA:
+		buffer->flags = 0;
+		return __sim_buffer_done(sim, session->session_id, pkt->port,
+			pkt->packet_id, buffer, msm_vidc_sim_latency_us);
+	case HFI_BUFFER_BITSTREAM:
+	case HFI_BUFFER_RAW:
+		break;
+	default:
+		/* internal buffers are held until released */
+		return 0;
+	}
+
+	/* decoder consumes bitstream and produces raw, encoder vice versa */
+	if ((pkt->port == HFI_PORT_BITSTREAM && buffer->type == HFI_BUFFER_BITSTREAM &&
+	     session->out_port != HFI_PORT_BITSTREAM) ||
+	    (pkt->port == HFI_PORT_RAW && buffer->type == HFI_BUFFER_RAW &&
+	     session->out_port == HFI_PORT_BITSTREAM))
+		return __sim_frame_done(sim, session, pkt->port, pkt->packet_id,
+			buffer);
+
+	if (session->out_count >= SIM_MAX_OUTPUTS) {
+		d_vpr_e("%s: %08x: too many output buffers\n",
+			__func__, session->session_id);
+		return -ENOMEM;
+	}
+
+	idx = (session->out_head + session->out_count) % SIM_MAX_OUTPUTS;
+	session->outputs[idx] = *buffer;
+	session->out_count++;
+
+	if (session->drain_pending)
+		return __sim_drain_done(sim, session, pkt->packet_id);
+
+	return 0;
+}
+
+static int __sim_handle_session_packet(struct msm_vidc_sim *sim,
+	struct hfi_header *hdr, struct hfi_packet *pkt)
+{
+	struct msm_vidc_sim_session *session;
+	int rc = 0;
+
+	session = __sim_get_session(sim, hdr->session_id);
+	if (pkt->type == HFI_CMD_OPEN) {
+		if (!session) {
+			session = kzalloc(sizeof(*session), GFP_KERNEL);
+			if (!session)
+				return -ENOMEM;
+			session->session_id = hdr->session_id;
+			list_add_tail(&session->list, &sim->sessions);
+		}
+		return __sim_ack(sim, hdr->session_id, pkt, 0);
+	}
+
+	if (!session) {
+		d_vpr_e("%s: %08x: unknown session, pkt %#x\n",
+			__func__, hdr->session_id, pkt->type);
+		return -EINVAL;
+	}
+
+	if (pkt->type > HFI_PROP_BEGIN && pkt->type < HFI_PROP_END) {
+		__sim_cache_property(session, pkt);
+		if (pkt->type == HFI_PROP_CODEC)
+			__sim_set_codec(session, pkt);
+		return 0;
+	}
+
+	switch (pkt->type) {
+	case HFI_CMD_BUFFER:
+		rc = __sim_handle_buffer(sim, session, pkt);
+		break;
+	case HFI_CMD_SUBSCRIBE_MODE:
+		__sim_subscribe(session, pkt);
+		rc = __sim_ack(sim, hdr->session_id, pkt, 0);
+		break;
+	case HFI_CMD_STOP:
+		if (pkt->port == session->out_port) {
+			rc = __sim_return_outputs(sim, session, pkt->packet_id);
+			if (rc)
+				break;
+		}
+		rc = __sim_ack(sim, hdr->session_id, pkt, 0);
+		break;
+	case HFI_CMD_DRAIN:
+		rc = __sim_ack(sim, hdr->session_id, pkt, 0);
+		if (rc)
+			break;
+		rc = __sim_drain_done(sim, session, pkt->packet_id);
+		break;
+	case HFI_CMD_CLOSE:
+		rc = __sim_ack(sim, hdr->session_id, pkt, 0);
+		list_del(&session->list);
+		kfree(session);
+		break;
+	case HFI_CMD_START:
+	case HFI_CMD_DELIVERY_MODE:
+	case HFI_CMD_PAUSE:
+	case HFI_CMD_RESUME:
+	case HFI_CMD_STABILITY:
+		rc = __sim_ack(sim, hdr->session_id, pkt, 0);
+		break;
+	default:
+		d_vpr_l("%s: %08x: ignoring pkt %#x\n",
+			__func__, hdr->session_id, pkt->type);
+		break;
+	}
+
+	return rc;
+}
+
+static int __sim_handle_system_packet(struct msm_vidc_sim *sim,
+	struct hfi_packet *pkt)
+{
+	char version[VENUS_VERSION_LENGTH] = SIM_FW_VERSION;
+	int rc = 0;
+
+	switch (pkt->type) {
+	case HFI_CMD_INIT:
+		/* fresh boot, forget about all sessions */
+		__sim_reset(sim);
+		rc = __sim_ack(sim, 0, pkt, 0);
+		break;
+	case HFI_PROP_IMAGE_VERSION:
+		rc = __sim_create_header(sim, 0);
+		if (rc)
+			break;
+		rc = hfi_create_packet(sim->rsp_pkt, VIDC_IFACEQ_VAR_HUGE_PKT_SIZE,
+				       HFI_PROP_IMAGE_VERSION, HFI_FW_FLAGS_SUCCESS,
+				       HFI_PAYLOAD_STRING, HFI_PORT_NONE,
+				       pkt->packet_id, version, sizeof(version));
+		if (rc)
+			break;
+		rc = __sim_post(sim, 0);
+		break;
+	default:
+		d_vpr_l("%s: ignoring pkt %#x\n", __func__, pkt->type);
+		break;
+	}
+
+	return rc;
+}
+
+static void __sim_handle_cmd(struct msm_vidc_sim *sim, struct hfi_header *hdr)
+{
+	struct hfi_packet *pkt;
+	u8 *cur, *end;
+	u32 i;
+	int rc;
+
+	if (hdr->size < sizeof(struct hfi_header)) {
+		d_vpr_e("%s: invalid header size %u\n", __func__, hdr->size);
+		return;
+	}
+
+	cur = (u8 *)hdr + sizeof(struct hfi_header);
+	end = (u8 *)hdr + hdr->size;
+	for (i = 0; i < hdr->num_packets; i++) {
+		pkt = (struct hfi_packet *)cur;
+		if (cur + sizeof(struct hfi_packet) > end ||
+		    pkt->size < sizeof(struct hfi_packet) ||
+		    cur + pkt->size > end) {
+			d_vpr_e("%s: %08x: invalid packet %u\n",
+				__func__, hdr->session_id, i);
+			return;
+		}
+
+		if (hdr->session_id)
+			rc = __sim_handle_session_packet(sim, hdr, pkt);
+		else
+			rc = __sim_handle_system_packet(sim, pkt);
+		if (rc)
+			d_vpr_e("%s: %08x: pkt %#x failed: %d\n",
+				__func__, hdr->session_id, pkt->type, rc);
+
+		cur += pkt->size;
+	}
+}
+
+static void __sim_cmd_work_handler(struct work_struct *work)
+{
+	struct msm_vidc_sim *sim;
+	struct hfi_queue_header *queue;
+
+	sim = container_of(work, struct msm_vidc_sim, cmd_work);
+
+	while (!__sim_read_cmdq(sim))
+		__sim_handle_cmd(sim, (struct hfi_header *)sim->cmd_pkt);
+
+	/* host is waiting for cmd queue space */
+	queue = sim->core->iface_queues[VIDC_IFACEQ_CMDQ_IDX].q_hdr;
+	if (queue && queue->qhdr_tx_req) {
+		atomic_or(SIM_INTR_STATUS, &sim->intr_status);
+		queue_work(sim->irq_workq, &sim->irq_work);
+	}
+}
+
+static void __sim_done_work_handler(struct work_struct *work)
+{
+	struct msm_vidc_sim *sim;
+
+	sim = container_of(work, struct msm_vidc_sim, done_work);
+
+	__sim_flush_responses(sim);
+}
+
+static void __sim_irq_work_handler(struct work_struct *work)
+{
+	struct msm_vidc_sim *sim;
+
+	sim = container_of(work, struct msm_vidc_sim, irq_work);
+
+	venus_hfi_process_responses(sim->core);
+}
+
+static enum hrtimer_restart __sim_done_timer_handler(struct hrtimer *timer)
+{
+	struct msm_vidc_sim *sim;
+
+	sim = container_of(timer, struct msm_vidc_sim, done_timer);
+	queue_work(sim->fw_workq, &sim->done_work);
+
+	return HRTIMER_NORESTART;
+}
+
+static int __boot_firmware_sim(struct msm_vidc_core *core)
+{
+	d_vpr_h("%s: sim firmware ready\n", __func__);
+	return 0;
+}
+
+static int __raise_interrupt_sim(struct msm_vidc_core *core)
+{
+	struct msm_vidc_sim *sim = core->variant_data;
+
+	queue_work(sim->fw_workq, &sim->cmd_work);
+	return 0;
+}
+
+static int __clear_interrupt_sim(struct msm_vidc_core *core)
+{
+	struct msm_vidc_sim *sim = core->variant_data;
+
+	core->intr_status = atomic_xchg(&sim->intr_status, 0);
+	return 0;
+}
+
+static int __power_on_sim(struct msm_vidc_core *core)
+{
+	return 0;
+}
+
+static int __power_off_sim(struct msm_vidc_core *core)
+{
+	return 0;
+}
+
+static int __prepare_pc_sim(struct msm_vidc_core *core)
+{
+	return 0;
+}
+
+static int __watchdog_sim(struct msm_vidc_core *core, u32 intr_status)
+{
+	return 0;
+}
+
+static struct msm_vidc_venus_ops sim_ops = {
+	.boot_firmware = __boot_firmware_sim,
+	.raise_interrupt = __raise_interrupt_sim,
+	.clear_interrupt = __clear_interrupt_sim,
+	.power_on = __power_on_sim,
+	.power_off = __power_off_sim,
+	.prepare_pc = __prepare_pc_sim,
+	.watchdog = __watchdog_sim,
+};
+
+/* no clocks, regulators or irq to manage for the software model */
+static const struct msm_vidc_resources_ops sim_res_ops = {
+};
+
+static void msm_vidc_deinit_sim(void *res)
+{
+	struct msm_vidc_sim *sim = res;
+
+	/* firmware work raises irq work, so it goes first */
+	if (sim->fw_workq) {
+		hrtimer_cancel(&sim->done_timer);
+		flush_workqueue(sim->fw_workq);
+		__sim_reset(sim);
+		destroy_workqueue(sim->fw_workq);
+	}
+
+	if (sim->irq_workq)
+		destroy_workqueue(sim->irq_workq);
+
+	sim->core->variant_data = NULL;
+}
+
+int msm_vidc_init_sim(struct msm_vidc_core *core)
+{
+	struct device *dev = &core->pdev->dev;
+	struct msm_vidc_sim *sim;
+	int rc = 0;
+
+	d_vpr_h("%s()\n", __func__);
+
+	/* session ops are those of the emulated iris2 */
+	rc = msm_vidc_init_iris2(core);
+	if (rc)
+		return rc;
+
+	sim = devm_kzalloc(dev, sizeof(*sim), GFP_KERNEL);
+	if (!sim)
+		return -ENOMEM;
+
+	sim->cmd_pkt = devm_kzalloc(dev, VIDC_IFACEQ_VAR_HUGE_PKT_SIZE, GFP_KERNEL);
+	sim->rsp_pkt = devm_kzalloc(dev, VIDC_IFACEQ_VAR_HUGE_PKT_SIZE, GFP_KERNEL);
+	if (!sim->cmd_pkt || !sim->rsp_pkt)
+		return -ENOMEM;
+
+	sim->core = core;
+	INIT_LIST_HEAD(&sim->sessions);
+	INIT_LIST_HEAD(&sim->responses);
+	INIT_WORK(&sim->cmd_work, __sim_cmd_work_handler);
+	INIT_WORK(&sim->done_work, __sim_done_work_handler);
+	INIT_WORK(&sim->irq_work, __sim_irq_work_handler);
+	hrtimer_init(&sim->done_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	sim->done_timer.function = __sim_done_timer_handler;
+
+	sim->fw_workq = alloc_ordered_workqueue("vidc_sim_fw", 0);
+	sim->irq_workq = alloc_ordered_workqueue("vidc_sim_irq", WQ_HIGHPRI);
+	if (!sim->fw_workq || !sim->irq_workq) {
+		d_vpr_e("%s: create sim workqueues failed\n", __func__);
+		msm_vidc_deinit_sim(sim);
+		return -ENOMEM;
+	}
+
+	rc = devm_add_action_or_reset(dev, msm_vidc_deinit_sim, sim);
+	if (rc)
+		return rc;
+
+	core->variant_data = sim;
+	core->venus_ops = &sim_ops;
+	core->res_ops = &sim_res_ops;
+	/* nothing to download, see fw_load() */
+	core->no_fw_image = true;
+
+	return 0;
+}
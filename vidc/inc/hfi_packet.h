@@ -38,6 +38,8 @@ int hfi_create_packet(u8 *packet, u32 packet_size,
 int hfi_create_buffer(u8 *packet, u32 packet_size, u32 *offset,
 		      enum msm_vidc_domain_type domain,
 		      struct msm_vidc_buffer *data);
+int hfi_update_packet_ids(struct msm_vidc_core *core,
+			  u8 *packet, u32 packet_size);
 int hfi_packet_sys_init(struct msm_vidc_core *core,
 			u8 *pkt, u32 pkt_size);
 int hfi_packet_image_version(struct msm_vidc_core *core,
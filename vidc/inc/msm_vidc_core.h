@@ -8,8 +8,12 @@
 #define _MSM_VIDC_CORE_H_
 
 #include <linux/platform_device.h>
+#include <linux/hrtimer.h>
+#include <linux/kfifo.h>
+#include <linux/shrinker.h>
 
 #include "msm_vidc_internal.h"
+#include "msm_vidc_memory.h"
 #include "msm_vidc_state.h"
 #include "venus_hfi_queue.h"
 #include "resources.h"
@@ -17,6 +21,7 @@
 struct msm_vidc_core;
 
 #define MAX_EVENTS   30
+#define VIDC_DBG_FIFO_SIZE   SZ_64K
 
 #define call_venus_op(d, op, ...)			\
 	(((d) && (d)->venus_ops && (d)->venus_ops->op) ? \
@@ -48,9 +53,67 @@ struct msm_vidc_mem_addr {
 	struct msm_vidc_mem mem;
 };
 
+struct msm_vidc_iface_q_stats {
+	u64 packets;
+	u64 bytes;
+	u32 max_used_words;
+	u32 full_count;
+	u32 tx_req_toggles;
+	u32 rx_req_toggles;
+	/* snapshot of the last debugfs read, for the rate computation */
+	u64 sample_packets;
+	u64 sample_bytes;
+	ktime_t sample_time;
+};
+
 struct msm_vidc_iface_q_info {
 	void *q_hdr;
 	struct msm_vidc_mem_addr q_array;
+	struct msm_vidc_iface_q_stats stats;
+};
+
+#define HFI_LATENCY_SLOTS       256
+#define HFI_LATENCY_BUCKETS     16
+
+/*
+ * Command to response latency, keyed by packet_id. Bucket 0 counts
+ * responses within 16us, bucket n covers [2^(n+3), 2^(n+4)) us and the
+ * last bucket everything above.
+ */
+struct msm_vidc_hfi_latency {
+	spinlock_t lock;
+	u32 packet_id[HFI_LATENCY_SLOTS];
+	ktime_t sent[HFI_LATENCY_SLOTS];
+	u64 hist[HFI_LATENCY_BUCKETS];
+	u64 count;
+	u64 total_us;
+	u32 max_us;
+};
+
+/*
+ * Non-secure internal buffer allocations freed by closed sessions, kept
+ * mapped for reuse by the next session asking for the same region and
+ * size. They are zeroed on reuse and released under memory pressure by
+ * the shrinker.
+ */
+struct msm_vidc_mem_cache {
+	struct mutex lock;
+	struct list_head list; /* struct msm_vidc_mem_cache_entry, oldest first */
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0))
+	struct shrinker *shrinker;
+#else
+	struct shrinker shrinker;
+#endif
+	u32 count;
+	u64 size;
+	u64 hits;
+	u64 misses;
+	u64 evictions;
+};
+
+struct msm_vidc_mem_cache_entry {
+	struct list_head list;
+	struct msm_vidc_mem mem;
 };
 
 struct msm_video_device {
@@ -103,6 +166,28 @@ struct msm_vidc_core {
 	struct workqueue_struct               *batch_workq;
 	struct delayed_work                    fw_unload_work;
 	struct work_struct                     ssr_work;
+	struct hrtimer                         doorbell_timer;
+	struct work_struct                     doorbell_work;
+	u32                                    doorbell_pending;
+	u64                                    doorbell_raised;
+	u64                                    doorbell_deferred;
+	u64                                    intr_count;
+	u64                                    msg_count;
+	u64                                    poll_count;
+	struct msm_vidc_hfi_latency            hfi_latency;
+	struct workqueue_struct               *dbg_workq;
+	struct work_struct                     dbg_work;
+	struct kfifo_rec_ptr_2                 dbg_fifo;
+	u8                                    *dbg_log;
+	u64                                    dbg_msg_count;
+	u64                                    dbg_dropped;
+	struct list_head                       cmdq_backlog;
+	u32                                    cmdq_backlog_count;
+	u32                                    cmdq_backlog_sessions; /* with packets parked */
+	u64                                    cmdq_parked;
+	struct kmem_cache                     *pool_cache[MSM_MEM_POOL_MAX];
+	struct msm_vidc_mem_cache              mem_cache;
+	atomic64_t                             mem_usage; /* sum of inst mem_usage.total */
 	struct msm_vidc_core_power             power;
 	struct msm_vidc_ssr                    ssr;
 	u32                                    skip_pc_count;
@@ -123,6 +208,8 @@ struct msm_vidc_core {
 	const struct msm_vidc_memory_ops      *mem_ops;
 	struct media_device_ops               *media_device_ops;
 	const struct msm_vidc_fence_ops       *fence_ops;
+	void                                  *variant_data; /* e.g. sim model */
+	bool                                   no_fw_image;
 	u32                                    header_id;
 	u32                                    packet_id;
 	u32                                    sys_init_id;
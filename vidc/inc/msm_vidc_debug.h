@@ -44,6 +44,19 @@ extern int msm_vidc_llc_bw;
 extern bool msm_vidc_fw_dump;
 extern unsigned int msm_vidc_enable_bugon;
 extern bool msm_vidc_synx_fence_enable;
+extern unsigned int msm_vidc_doorbell_batch;
+extern unsigned int msm_vidc_doorbell_delay_us;
+extern unsigned int msm_vidc_poll_time_us;
+extern unsigned int msm_vidc_poll_budget;
+extern unsigned int msm_vidc_cmdq_backlog_max;
+extern unsigned int msm_vidc_map_cache_mb;
+extern unsigned int msm_vidc_mem_cache_mb;
+extern unsigned int msm_vidc_lazy_dpb_count;
+extern unsigned int msm_vidc_mem_budget_mb;
+extern unsigned int msm_vidc_internal_chunk_kb;
+extern unsigned int msm_vidc_internal_arena;
+extern unsigned int msm_vidc_check_attr_count;
+extern unsigned int msm_vidc_sim_latency_us;
 
 /* do not modify the log message as it is used in test scripts */
 #define FMT_STRING_SET_CTRL \
@@ -75,6 +75,21 @@ static inline bool is_output_meta_buffer(enum msm_vidc_buffer_type buffer_type)
 	return buffer_type == MSM_VIDC_BUF_OUTPUT_META;
 }
 
+static inline bool is_meta_buffer(enum msm_vidc_buffer_type buffer_type)
+{
+	return is_input_meta_buffer(buffer_type) ||
+		is_output_meta_buffer(buffer_type);
+}
+
+static inline struct msm_vidc_buffer *msm_vidc_buffer_by_index(
+	struct msm_vidc_buffers *buffers, u32 index)
+{
+	if (!buffers->table || index >= buffers->table_size)
+		return NULL;
+
+	return buffers->table[index];
+}
+
 static inline bool is_ts_reorder_allowed(struct msm_vidc_inst *inst)
 {
 	return !!(inst->capabilities[TS_REORDER].value &&
@@ -448,6 +463,9 @@ int msm_vidc_get_internal_buffers(struct msm_vidc_inst *inst,
 				  enum msm_vidc_buffer_type buffer_type);
 int msm_vidc_create_internal_buffers(struct msm_vidc_inst *inst,
 				     enum msm_vidc_buffer_type buffer_type);
+int msm_vidc_reserve_internal_arena(struct msm_vidc_inst *inst,
+				    const u32 *types, u32 count);
+void msm_vidc_release_internal_arena(struct msm_vidc_inst *inst);
 int msm_vidc_queue_internal_buffers(struct msm_vidc_inst *inst,
 				    enum msm_vidc_buffer_type buffer_type);
 int msm_vidc_alloc_and_queue_session_internal_buffers(struct msm_vidc_inst *inst,
@@ -515,6 +533,21 @@ int msm_vidc_allocate_buffers(struct msm_vidc_inst *inst,
 			  enum msm_vidc_buffer_type buf_type, u32 num_buffers);
 int msm_vidc_free_buffers(struct msm_vidc_inst *inst,
 			  enum msm_vidc_buffer_type buf_type);
+int msm_vidc_prealloc_pools(struct msm_vidc_inst *inst);
+bool msm_vidc_map_cache_get(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf, struct device *dev);
+bool msm_vidc_map_cache_put(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf);
+void msm_vidc_map_cache_flush(struct msm_vidc_inst *inst,
+	enum msm_vidc_buffer_type type);
+int msm_vidc_mem_cache_init(struct msm_vidc_core *core);
+void msm_vidc_mem_cache_deinit(struct msm_vidc_core *core);
+void msm_vidc_mem_cache_shrink(struct msm_vidc_core *core);
+void msm_vidc_mem_account(struct msm_vidc_inst *inst, u64 *counter, s64 bytes);
+struct sg_table *msm_vidc_map_dmabuf(struct msm_vidc_inst *inst,
+	struct dma_buf_attachment *attach);
+void msm_vidc_unmap_dmabuf(struct msm_vidc_inst *inst,
+	struct dma_buf_attachment *attach, struct sg_table *table);
 void msm_vidc_update_stats(struct msm_vidc_inst *inst,
 			   struct msm_vidc_buffer *buf,
 			   enum msm_vidc_debugfs_event etype);
@@ -532,6 +565,7 @@ int msm_vidc_queue_buffer_single(struct msm_vidc_inst *inst,
 				 struct vb2_buffer *vb2);
 int msm_vidc_queue_deferred_buffers(struct msm_vidc_inst *inst,
 				    enum msm_vidc_buffer_type buf_type);
+int msm_vidc_queue_held_buffers(struct msm_vidc_inst *inst);
 int msm_vidc_destroy_internal_buffer(struct msm_vidc_inst *inst,
 				     struct msm_vidc_buffer *buffer);
 void msm_vidc_destroy_buffers(struct msm_vidc_inst *inst);
@@ -567,7 +601,7 @@ int msm_vidc_process_resume(struct msm_vidc_inst *inst);
 int msm_vidc_process_streamon_input(struct msm_vidc_inst *inst);
 int msm_vidc_process_streamon_output(struct msm_vidc_inst *inst);
 int msm_vidc_process_stop_done(struct msm_vidc_inst *inst,
-			       enum signal_session_response signal_type);
+			       enum msm_vidc_port_type port);
 int msm_vidc_process_drain_done(struct msm_vidc_inst *inst);
 int msm_vidc_process_drain_last_flag(struct msm_vidc_inst *inst);
 int msm_vidc_process_psc_last_flag(struct msm_vidc_inst *inst);
@@ -577,6 +611,8 @@ int msm_vidc_get_fps(struct msm_vidc_inst *inst);
 int msm_vidc_num_buffers(struct msm_vidc_inst *inst,
 			 enum msm_vidc_buffer_type type,
 			 enum msm_vidc_buffer_attributes attr);
+void msm_vidc_update_buffer_attr(struct msm_vidc_inst *inst,
+				 struct msm_vidc_buffer *buf, u32 set, u32 clear);
 void core_lock(struct msm_vidc_core *core, const char *function);
 void core_unlock(struct msm_vidc_core *core, const char *function);
 void inst_lock(struct msm_vidc_inst *inst, const char *function);
@@ -597,11 +633,13 @@ bool msm_vidc_allow_decode_batch(struct msm_vidc_inst *inst);
 int msm_vidc_check_session_supported(struct msm_vidc_inst *inst);
 int msm_vidc_check_core_mbps(struct msm_vidc_inst *inst);
 int msm_vidc_check_core_mbpf(struct msm_vidc_inst *inst);
+int msm_vidc_check_core_mem(struct msm_vidc_inst *inst);
 int msm_vidc_check_scaling_supported(struct msm_vidc_inst *inst);
 int msm_vidc_update_timestamp_rate(struct msm_vidc_inst *inst, u64 timestamp);
 int msm_vidc_set_auto_framerate(struct msm_vidc_inst *inst, u64 timestamp);
 int msm_vidc_get_timestamp_rate(struct msm_vidc_inst *inst);
 int msm_vidc_flush_ts(struct msm_vidc_inst *inst);
+int msm_vidc_ts_reorder_reserve(struct msm_vidc_inst *inst);
 int msm_vidc_ts_reorder_insert_timestamp(struct msm_vidc_inst *inst, u64 timestamp);
 int msm_vidc_ts_reorder_remove_timestamp(struct msm_vidc_inst *inst, u64 timestamp);
 int msm_vidc_ts_reorder_get_first_timestamp(struct msm_vidc_inst *inst, u64 *timestamp);
@@ -616,8 +654,12 @@ bool res_is_less_than(u32 width, u32 height,
 bool res_is_less_than_or_equal_to(u32 width, u32 height,
 				  u32 ref_width, u32 ref_height);
 bool is_hevc_10bit_decode_session(struct msm_vidc_inst *inst);
-int signal_session_msg_receipt(struct msm_vidc_inst *inst,
-			       enum signal_session_response cmd);
+void msm_vidc_track_session_cmd(struct msm_vidc_inst *inst, u32 type,
+				u32 port, u32 packet_id);
+void msm_vidc_session_cmd_done(struct msm_vidc_inst *inst, u32 type,
+			       u32 port, u32 packet_id);
+int msm_vidc_wait_for_session_cmd(struct msm_vidc_inst *inst, u32 packet_id,
+				  const char *func);
 int msm_vidc_get_properties(struct msm_vidc_inst *inst);
 int msm_vidc_update_input_rate(struct msm_vidc_inst *inst, u64 time_us);
 int msm_vidc_add_buffer_stats(struct msm_vidc_inst *inst,
@@ -639,6 +681,8 @@ struct context_bank_info
 struct context_bank_info
 	*msm_vidc_get_context_bank_for_device(struct msm_vidc_core *core, struct device *dev);
 
+void msm_vidc_update_cache_hints(struct msm_vidc_inst *inst,
+	struct v4l2_buffer *b);
 int msm_vidc_qbuf_cache_operation(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf);
 int msm_vidc_dqbuf_cache_operation(struct msm_vidc_inst *inst,
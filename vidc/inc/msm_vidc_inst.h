@@ -43,6 +43,53 @@ struct msm_vidc_mem_list_info {
 	struct msm_vidc_mem_list        partial_data;
 };
 
+struct msm_vidc_map_cache {
+	struct list_head               list; /* struct msm_memory_map, LRU first */
+	DECLARE_HASHTABLE(hash, MSM_MEM_DMABUF_HASH_BITS); /* same entries */
+	u32                            count;
+	u64                            size;
+	u64                            pinned_size; /* part of size not budgeted */
+	u64                            hits;
+	u64                            misses;
+	u64                            evictions;
+};
+
+struct msm_vidc_cache_stats {
+	u64                            performed;
+	u64                            skipped;
+	u64                            performed_bytes;
+	u64                            skipped_bytes;
+};
+
+/*
+ * Large allocation internal buffers of a session are carved out of, so
+ * that they share a few large IOMMU mappings instead of one each. Space
+ * given back by a buffer is reused by the next one that fits.
+ */
+struct msm_vidc_mem_chunk {
+	struct list_head               list;
+	struct msm_vidc_mem            mem;
+	struct gen_pool               *pool; /* free IOVA ranges of mem */
+	u32                            refcount;
+};
+
+struct msm_vidc_mem_chunks {
+	struct list_head               list; /* struct msm_vidc_mem_chunk */
+	u32                            count;
+	u64                            size; /* charged to the session */
+	u64                            used;
+};
+
+/* memory owned by a session, charged through msm_vidc_mem_account() */
+struct msm_vidc_mem_usage {
+	/* carved buffers are counted here but charged through mem_chunks.size */
+	u64                            internal[MSM_VIDC_BUF_PARTIAL_DATA + 1];
+	u64                            pool;
+	u64                            packet;
+	u64                            dmabuf; /* mapped client dmabufs */
+	u64                            total;
+};
+
 struct msm_vidc_buffers_info {
 	struct msm_vidc_buffers        input;
 	struct msm_vidc_buffers        output;
@@ -82,7 +129,9 @@ struct msm_vidc_inst {
 	u32                                session_id;
 	u8                                 debug_str[24];
 	void                              *packet;
+	void                              *prop_packet;
 	u32                                packet_size;
+	u32                                prop_batch;
 	struct v4l2_format                 fmts[MAX_PORT];
 	struct v4l2_ctrl_handler           ctrl_handler;
 	struct v4l2_fh                     fh;
@@ -100,8 +149,12 @@ struct msm_vidc_inst {
 	struct msm_memory_pool             pool[MSM_MEM_POOL_MAX];
 	struct msm_vidc_buffers_info       buffers;
 	struct msm_vidc_mem_list_info      mem_info;
-	struct msm_vidc_timestamps         timestamps;
-	struct msm_vidc_timestamps         ts_reorder; /* struct msm_vidc_timestamp */
+	struct msm_vidc_map_cache          map_cache;
+	struct msm_vidc_cache_stats        cache_stats;
+	struct msm_vidc_mem_chunks         mem_chunks;
+	struct msm_vidc_mem_usage          mem_usage;
+	struct msm_vidc_ts_window          timestamps;
+	struct msm_vidc_ts_heap            ts_reorder;
 	struct msm_vidc_subscription_params       subcr_params[MAX_PORT];
 	struct msm_vidc_hfi_frame_info     hfi_frame_info;
 	struct msm_vidc_decode_batch       decode_batch;
@@ -113,6 +166,7 @@ struct msm_vidc_inst {
 	struct workqueue_struct           *workq;
 	struct list_head                   enc_input_crs;
 	struct list_head                   dmabuf_tracker; /* struct msm_memory_dmabuf */
+	DECLARE_HASHTABLE(dmabuf_hash, MSM_MEM_DMABUF_HASH_BITS); /* struct msm_memory_dmabuf */
 	struct list_head                   input_timer_list; /* struct msm_vidc_input_timer */
 	struct list_head                   caps_list;
 	struct list_head                   children_list; /* struct msm_vidc_inst_cap_entry */
@@ -129,13 +183,21 @@ struct msm_vidc_inst {
 	struct debug_buf_count             debug_count;
 	struct msm_vidc_statistics         stats;
 	struct msm_vidc_inst_cap           capabilities[INST_CAP_MAX + 1];
-	struct completion                  completions[MAX_SIGNAL];
+	struct completion                  cmds_done;
+	struct msm_vidc_pending_cmd        pending_cmds[MAX_PENDING_CMDS];
+	u32                                pending_cmd_next;
+	u32                                last_cmd_id;
+	u32                                wait_cmd_id;
+	u32                                hfi_burst;
+	u32                                cmdq_parked; /* packets on the cmdq backlog */
+	u32                                backlog_held; /* BIT(buffer type) held by the driver */
 	struct msm_vidc_fence_context      fence_context;
 	bool                               active;
 	u64                                last_qbuf_time_ns;
 	u64                                initial_time_us;
 	u32                                max_input_data_size;
 	u32                                dpb_list_payload[MAX_DPB_LIST_ARRAY_SIZE];
+	struct msm_vidc_dpb_set            dpb_set;
 	bool                               input_dpb_list_enabled;
 	bool                               output_dpb_list_enabled;
 	u32                                auto_framerate;
@@ -145,6 +207,7 @@ struct msm_vidc_inst {
 	u32                                adjust_priority;
 	bool                               iframe;
 	u32                                fw_min_count;
+	u32                                lazy_dpb_count; /* latched at output streamon */
 };
 
 #endif // _MSM_VIDC_INST_H_
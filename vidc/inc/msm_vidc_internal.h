@@ -14,6 +14,7 @@
 #include <linux/spinlock.h>
 #include <linux/sync_file.h>
 #include <linux/dma-fence.h>
+#include <linux/hashtable.h>
 #include <media/v4l2-dev.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-ioctl.h>
@@ -144,6 +145,9 @@ enum msm_vidc_metadata_bits {
 #define DCVS_WINDOW 16
 #define ENC_FPS_WINDOW 3
 #define DEC_FPS_WINDOW 10
+#define MAX_FPS_WINDOW DEC_FPS_WINDOW
+#define MIN_TS_REORDER_SIZE 16
+#define MSM_VIDC_TS_HASH_BITS 5
 #define INPUT_TIMER_LIST_SIZE 30
 
 #define DEFAULT_COMPLEXITY 50
@@ -213,6 +217,8 @@ enum msm_vidc_metadata_bits {
   */
 #define MAX_DPB_LIST_ARRAY_SIZE (16 * 4)
 #define MAX_DPB_LIST_PAYLOAD_SIZE (16 * 4 * 4)
+#define MAX_DPB_LIST_ENTRIES (MAX_DPB_LIST_ARRAY_SIZE / 4)
+#define MSM_VIDC_DPB_HASH_BITS 5
 
 #define GENERATE_ENUM(ENUM) ENUM,
 #define GENERATE_STRING(STRING) (#STRING),
@@ -497,6 +503,8 @@ enum msm_vidc_buffer_attributes {
 	MSM_VIDC_ATTR_RELEASE_ELIGIBLE          = BIT(6),
 };
 
+#define MSM_VIDC_ATTR_COUNT 7
+
 enum msm_vidc_buffer_region {
 	MSM_VIDC_REGION_NONE = 0,
 	MSM_VIDC_NON_SECURE,
@@ -765,11 +773,13 @@ enum profiling_points {
 	MAX_PROFILING_POINTS,
 };
 
-enum signal_session_response {
-	SIGNAL_CMD_STOP_INPUT = 0,
-	SIGNAL_CMD_STOP_OUTPUT,
-	SIGNAL_CMD_CLOSE,
-	MAX_SIGNAL,
+/* session commands awaiting a firmware response */
+#define MAX_PENDING_CMDS 16
+
+struct msm_vidc_pending_cmd {
+	u32                    type; /* 0 if the slot is free */
+	u32                    port;
+	u32                    packet_id;
 };
 
 struct profile_data {
@@ -853,6 +863,19 @@ struct msm_vidc_decode_batch {
 	struct delayed_work    work;
 };
 
+struct msm_vidc_dpb_entry {
+	struct hlist_node      hnode; /* keyed by device_addr */
+	u64                    device_addr;
+	u32                    data_offset;
+};
+
+/* last dpb list reported by firmware, decoded for O(1) lookups */
+struct msm_vidc_dpb_set {
+	DECLARE_HASHTABLE(hash, MSM_VIDC_DPB_HASH_BITS);
+	struct msm_vidc_dpb_entry entries[MAX_DPB_LIST_ENTRIES];
+	u32                    count;
+};
+
 enum msm_vidc_power_mode {
 	VIDC_POWER_NORMAL = 0,
 	VIDC_POWER_LOW,
@@ -955,6 +978,7 @@ struct msm_vidc_mem {
 	struct dma_buf_attachment  *attach;
 	phys_addr_t                 phys_addr;
 	enum dma_data_direction     direction;
+	struct msm_vidc_mem_chunk  *chunk; /* carved out of this session chunk */
 };
 
 struct msm_vidc_mem_list {
@@ -983,6 +1007,9 @@ struct msm_vidc_buffer {
 	unsigned long                      dma_attrs;
 	void                              *kvaddr;
 	u32                                dbuf_get:1;
+	u32                                dpb_ref:1; /* present in dpb_set */
+	u32                                no_cache_clean:1; /* qbuf hint */
+	u32                                no_cache_inval:1; /* qbuf hint */
 	u64                                fence_id;
 	u32                                start_time_ms;
 	u32                                end_time_ms;
@@ -990,6 +1017,11 @@ struct msm_vidc_buffer {
 
 struct msm_vidc_buffers {
 	struct list_head       list; // list of "struct msm_vidc_buffer"
+	/* vb2 index addressed view of list, for client buffer lookups */
+	struct msm_vidc_buffer **table;
+	u32                    table_size;
+	/* table buffers per attribute bit, see msm_vidc_update_buffer_attr */
+	u32                    attr_count[MSM_VIDC_ATTR_COUNT];
 	u32                    min_count;
 	u32                    extra_count;
 	u32                    actual_count;
@@ -1017,20 +1049,28 @@ enum msm_vidc_buffer_stats_flag {
 	MSM_VIDC_STATS_FLAG_SUBFRAME_INPUT = BIT(3),
 };
 
-struct msm_vidc_sort {
-	struct list_head       list;
+struct msm_vidc_ts_entry {
+	struct hlist_node      hnode; /* keyed by val, or on the free list */
 	s64                    val;
+	u32                    pos; /* index in heap */
 };
 
-struct msm_vidc_timestamp {
-	struct msm_vidc_sort   sort;
-	u64                    rank;
+/* min-heap of the input timestamps pending on output, for ts reorder */
+struct msm_vidc_ts_heap {
+	struct msm_vidc_ts_entry  *entries;
+	struct msm_vidc_ts_entry **heap;
+	struct hlist_head      free;
+	DECLARE_HASHTABLE(hash, MSM_VIDC_TS_HASH_BITS);
+	u32                    count;
+	u32                    size;
 };
 
-struct msm_vidc_timestamps {
-	struct list_head       list;
+/* last FPS window timestamps, kept both in arrival and in sorted order */
+struct msm_vidc_ts_window {
+	s64                    ring[MAX_FPS_WINDOW];
+	s64                    sorted[MAX_FPS_WINDOW];
+	u32                    head; /* oldest entry in ring */
 	u32                    count;
-	u64                    rank;
 };
 
 struct msm_vidc_input_timer {
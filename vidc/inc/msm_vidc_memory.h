@@ -7,27 +7,44 @@
 #ifndef _MSM_VIDC_MEMORY_H_
 #define _MSM_VIDC_MEMORY_H_
 
+#include <linux/hashtable.h>
+
 #include "msm_vidc_internal.h"
 
 struct msm_vidc_core;
 struct msm_vidc_inst;
 
 #define MSM_MEM_POOL_PACKET_SIZE 1024
+#define MSM_MEM_POOL_MIN_FREE    16
+#define MSM_MEM_DMABUF_HASH_BITS 7
 
 struct msm_memory_dmabuf {
 	struct list_head       list;
+	struct hlist_node      hnode; /* keyed by dmabuf */
 	struct dma_buf        *dmabuf;
 	u32                    refcount;
 };
 
+struct msm_memory_map {
+	struct list_head            list;
+	struct hlist_node           hnode; /* keyed by dmabuf */
+	enum msm_vidc_buffer_type   type;
+	struct dma_buf             *dmabuf;
+	struct dma_buf_attachment  *attach;
+	struct sg_table            *sg_table;
+	u64                         device_addr;
+	u64                         size;
+	bool                        pinned; /* metadata, kept whatever the budget */
+};
+
 enum msm_memory_pool_type {
 	MSM_MEM_POOL_BUFFER  = 0,
 	MSM_MEM_POOL_ALLOC_MAP,
-	MSM_MEM_POOL_TIMESTAMP,
 	MSM_MEM_POOL_DMABUF,
 	MSM_MEM_POOL_PACKET,
 	MSM_MEM_POOL_BUF_TIMER,
 	MSM_MEM_POOL_BUF_STATS,
+	MSM_MEM_POOL_MAP,
 	MSM_MEM_POOL_MAX,
 };
 
@@ -47,15 +64,27 @@ struct msm_memory_alloc_header {
 struct msm_memory_pool {
 	u32                    size;
 	char                  *name;
+	struct kmem_cache     *cache;
 	struct list_head       free_pool; /* list of struct msm_memory_alloc_header */
 	struct list_head       busy_pool; /* list of struct msm_memory_alloc_header */
+	u32                    free_count;
+	u32                    busy_count;
+	u32                    max_free;
+	u32                    peak_busy;
+	u64                    cache_allocs;
+	u64                    cache_frees;
+	u64                    reuse_count;
 };
 
 void *msm_vidc_pool_alloc(struct msm_vidc_inst *inst,
 			  enum msm_memory_pool_type type);
 void msm_vidc_pool_free(struct msm_vidc_inst *inst, void *vidc_buf);
+int msm_vidc_pool_prealloc(struct msm_vidc_inst *inst,
+			   enum msm_memory_pool_type type, u32 count);
 int msm_vidc_pools_init(struct msm_vidc_inst *inst);
 void msm_vidc_pools_deinit(struct msm_vidc_inst *inst);
+int msm_vidc_pool_caches_init(struct msm_vidc_core *core);
+void msm_vidc_pool_caches_deinit(struct msm_vidc_core *core);
 
 #define call_mem_op(c, op, ...)                  \
 	(((c) && (c)->mem_ops && (c)->mem_ops->op) ? \
@@ -204,6 +204,7 @@ struct context_bank_info {
 	struct iommu_domain       *domain;
 	u32                        region;
 	u64                        dma_mask;
+	atomic64_t                 iova_size; /* bytes mapped through this bank */
 };
 
 struct context_bank_set {
@@ -43,6 +43,8 @@ int venus_hfi_session_command(struct msm_vidc_inst *inst,
 			      u32 cmd, enum msm_vidc_port_type port,
 			      u32 payload_type,
 			      void *payload, u32 payload_size);
+bool venus_hfi_session_backlogged(struct msm_vidc_inst *inst);
+void venus_hfi_session_backlog_drop(struct msm_vidc_inst *inst);
 int venus_hfi_queue_buffer(struct msm_vidc_inst *inst,
 			   struct msm_vidc_buffer *buffer,
 			   struct msm_vidc_buffer *metabuf);
@@ -55,6 +57,12 @@ int venus_hfi_start(struct msm_vidc_inst *inst, enum msm_vidc_port_type port);
 int venus_hfi_stop(struct msm_vidc_inst *inst, enum msm_vidc_port_type port);
 int venus_hfi_session_close(struct msm_vidc_inst *inst);
 int venus_hfi_session_open(struct msm_vidc_inst *inst);
+void venus_hfi_session_burst_begin(struct msm_vidc_inst *inst);
+void venus_hfi_session_burst_flush(struct msm_vidc_inst *inst);
+void venus_hfi_session_burst_end(struct msm_vidc_inst *inst);
+void venus_hfi_session_prop_batch_begin(struct msm_vidc_inst *inst);
+int venus_hfi_session_prop_batch_end(struct msm_vidc_inst *inst);
+void venus_hfi_session_prop_batch_abort(struct msm_vidc_inst *inst);
 int venus_hfi_session_pause(struct msm_vidc_inst *inst, enum msm_vidc_port_type port);
 int venus_hfi_session_resume(struct msm_vidc_inst *inst,
 			     enum msm_vidc_port_type port, u32 payload);
@@ -75,8 +83,12 @@ int venus_hfi_scale_buses(struct msm_vidc_inst *inst, u64 bw_ddr, u64 bw_llcc);
 int venus_hfi_set_ir_period(struct msm_vidc_inst *inst, u32 ir_type,
 			    enum msm_vidc_inst_capability_type cap_id);
 void venus_hfi_pm_work_handler(struct work_struct *work);
+void venus_hfi_doorbell_work_handler(struct work_struct *work);
+void venus_hfi_dbg_work_handler(struct work_struct *work);
+enum hrtimer_restart venus_hfi_doorbell_timer_handler(struct hrtimer *timer);
 irqreturn_t venus_hfi_isr(int irq, void *data);
 irqreturn_t venus_hfi_isr_handler(int irq, void *data);
+int venus_hfi_process_responses(struct msm_vidc_core *core);
 int __prepare_pc(struct msm_vidc_core *core);
 struct device_region_info
 	*venus_hfi_get_device_region_info(struct msm_vidc_core *core,
@@ -83,11 +83,23 @@ struct hfi_queue_header {
 					ALIGNED_MMAP_BUF_SIZE)
 
 struct msm_vidc_core;
+struct msm_vidc_inst;
 
 int venus_hfi_queue_cmd_write(struct msm_vidc_core *core, void *pkt);
 int venus_hfi_queue_cmd_write_intr(struct msm_vidc_core *core, void *pkt,
 				   bool allow_intr);
-int venus_hfi_queue_msg_read(struct msm_vidc_core *core, void *pkt);
+int venus_hfi_queue_cmd_write_deferred(struct msm_vidc_core *core, void *pkt);
+void venus_hfi_queue_flush_doorbell(struct msm_vidc_core *core);
+void venus_hfi_queue_cmd_backlog_flush(struct msm_vidc_core *core);
+bool venus_hfi_queue_cmd_backlogged(struct msm_vidc_core *core,
+				   struct msm_vidc_inst *inst);
+void venus_hfi_queue_cmd_backlog_drop(struct msm_vidc_core *core,
+				      struct msm_vidc_inst *inst);
+int venus_hfi_queue_msg_begin(struct msm_vidc_core *core, u32 *read_idx);
+int venus_hfi_queue_msg_peek(struct msm_vidc_core *core, u32 *read_idx,
+			     u8 *buf, u8 **pkt, u32 *pkt_size);
+void venus_hfi_queue_msg_commit(struct msm_vidc_core *core, u32 start_idx,
+				u32 read_idx, bool rx_req);
 int venus_hfi_queue_dbg_read(struct msm_vidc_core *core, void *pkt);
 void venus_hfi_queue_deinit(struct msm_vidc_core *core);
 int venus_hfi_queue_init(struct msm_vidc_core *core);
@@ -10,7 +10,7 @@
 #include "hfi_packet.h"
 
 int handle_response(struct msm_vidc_core *core,
-		    void *response);
+		    void *response, u32 response_size);
 int validate_packet(u8 *response_pkt, u8 *core_resp_pkt,
 		    u32 core_resp_pkt_size, const char *func);
 bool is_valid_port(struct msm_vidc_inst *inst, u32 port,
@@ -178,10 +178,23 @@ exit:
 	return rc;
 }
 
+/*
+ * Platforms without a firmware image (e.g. the sim variant) run the HFI
+ * protocol against a software model, there is nothing to load or to
+ * hand over to TZ for them.
+ */
+static inline bool is_fw_image_present(struct msm_vidc_core *core)
+{
+	return !core->no_fw_image && !!core->platform->data.fwname;
+}
+
 int fw_load(struct msm_vidc_core *core)
 {
 	int rc;
 
+	if (!is_fw_image_present(core))
+		return 0;
+
 	if (!core->resource->fw_cookie) {
 		core->resource->fw_cookie = __load_fw_to_memory(core->pdev,
 								core->platform->data.fwname);
@@ -226,11 +239,17 @@ int fw_unload(struct msm_vidc_core *core)
 
 int fw_suspend(struct msm_vidc_core *core)
 {
+	if (!is_fw_image_present(core))
+		return 0;
+
 	return qcom_scm_set_remote_state(TZBSP_VIDEO_STATE_SUSPEND, 0);
 }
 
 int fw_resume(struct msm_vidc_core *core)
 {
+	if (!is_fw_image_present(core))
+		return 0;
+
 	return qcom_scm_set_remote_state(TZBSP_VIDEO_STATE_RESUME, 0);
 }
 
@@ -246,6 +265,9 @@ void fw_coredump(struct msm_vidc_core *core)
 	char *data = NULL, *dump = NULL;
 	u64 total_size;
 
+	if (!is_fw_image_present(core))
+		return;
+
 	pdev = core->pdev;
 
 	node = of_parse_phandle(pdev->dev.of_node, "memory-region", 0);
@@ -377,6 +377,43 @@ int hfi_create_packet(u8 *packet, u32 packet_size,
 	return 0;
 }
 
+int hfi_update_packet_ids(struct msm_vidc_core *core,
+			  u8 *packet, u32 packet_size)
+{
+	struct hfi_header *hdr;
+	struct hfi_packet *pkt;
+	u8 *ptr, *end;
+	u32 i;
+
+	if (!packet || packet_size < sizeof(struct hfi_header)) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+	hdr = (struct hfi_header *)packet;
+	if (hdr->size < sizeof(struct hfi_header) || hdr->size > packet_size) {
+		d_vpr_e("%s: invalid hdr size %d\n", __func__, hdr->size);
+		return -EINVAL;
+	}
+
+	ptr = packet + sizeof(struct hfi_header);
+	end = packet + hdr->size;
+	for (i = 0; i < hdr->num_packets; i++) {
+		pkt = (struct hfi_packet *)ptr;
+		if (ptr + sizeof(struct hfi_packet) > end ||
+		    pkt->size < sizeof(struct hfi_packet) ||
+		    ptr + pkt->size > end) {
+			d_vpr_e("%s: invalid packet %d of %d\n",
+				__func__, i, hdr->num_packets);
+			return -EINVAL;
+		}
+		pkt->packet_id = core->packet_id++;
+		ptr += pkt->size;
+	}
+	hdr->header_id = core->header_id++;
+
+	return 0;
+}
+
 int hfi_packet_sys_init(struct msm_vidc_core *core,
 			u8 *pkt, u32 pkt_size)
 {
@@ -643,13 +680,10 @@ int hfi_packet_session_command(struct msm_vidc_inst *inst,
 				u32 payload_type, void *payload, u32 payload_size)
 {
 	int rc = 0;
-	struct msm_vidc_core *core;
-
-	core = inst->core;
 
+	/* header and packet ids are assigned at commit time */
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-				   session_id,
-				   core->header_id++);
+				   session_id, 0);
 	if (rc)
 		goto err_cmd;
 
@@ -659,7 +693,7 @@ int hfi_packet_session_command(struct msm_vidc_inst *inst,
 				flags,
 				payload_type,
 				port,
-				core->packet_id++,
+				0,
 				payload,
 				payload_size);
 	if (rc)
@@ -700,26 +700,33 @@ static int msm_vdec_set_output_properties(struct msm_vidc_inst *inst)
 {
 	int rc = 0;
 
+	venus_hfi_session_prop_batch_begin(inst);
+
 	rc = msm_vdec_set_opb_enable(inst);
 	if (rc)
-		return rc;
+		goto exit;
 
 	rc = msm_vdec_set_colorformat(inst);
 	if (rc)
-		return rc;
+		goto exit;
 
 	rc = msm_vdec_set_linear_stride_scanline(inst);
 	if (rc)
-		return rc;
+		goto exit;
 
 	rc = msm_vdec_set_ubwc_stride_scanline(inst);
 	if (rc)
-		return rc;
+		goto exit;
 
 	rc = msm_vidc_set_session_priority(inst, PRIORITY);
 	if (rc)
-		return rc;
+		goto exit;
 
+exit:
+	if (rc)
+		venus_hfi_session_prop_batch_abort(inst);
+	else
+		rc = venus_hfi_session_prop_batch_end(inst);
 	return rc;
 }
 
@@ -824,22 +831,52 @@ int msm_vdec_create_input_internal_buffers(struct msm_vidc_inst *inst)
 	int rc = 0;
 	u32 i = 0;
 
+	rc = msm_vidc_reserve_internal_arena(inst, msm_vdec_internal_buffer_type,
+		ARRAY_SIZE(msm_vdec_internal_buffer_type));
+	if (rc)
+		return rc;
+
 	for (i = 0; i < ARRAY_SIZE(msm_vdec_internal_buffer_type); i++) {
 		rc = msm_vidc_create_internal_buffers(inst, msm_vdec_internal_buffer_type[i]);
 		if (rc)
-			return rc;
+			break;
 	}
+	msm_vidc_release_internal_arena(inst);
 
-	return 0;
+	return rc;
 }
 
 static int msm_vdec_create_output_internal_buffers(struct msm_vidc_inst *inst)
 {
-	int rc = 0;
+	struct msm_vidc_buffers *buffers;
+	int i, rc = 0;
+
+	if (!inst->lazy_dpb_count) {
+		rc = msm_vidc_reserve_internal_arena(inst,
+			msm_vdec_output_internal_buffer_type,
+			ARRAY_SIZE(msm_vdec_output_internal_buffer_type));
+		if (rc)
+			return rc;
+
+		rc = msm_vidc_create_internal_buffers(inst, MSM_VIDC_BUF_DPB);
+		msm_vidc_release_internal_arena(inst);
 
-	rc = msm_vidc_create_internal_buffers(inst, MSM_VIDC_BUF_DPB);
-	if (rc)
 		return rc;
+	}
+
+	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_DPB, __func__);
+	if (!buffers)
+		return -EINVAL;
+
+	if (buffers->reuse)
+		return 0;
+
+	/* lazy mode: the rest is added by msm_vdec_grow_dpb_buffers() */
+	for (i = 0; i < min(buffers->min_count, inst->lazy_dpb_count); i++) {
+		rc = msm_vidc_create_internal_buffer(inst, MSM_VIDC_BUF_DPB, i);
+		if (rc)
+			return rc;
+	}
 
 	return 0;
 }
@@ -1332,6 +1369,7 @@ static int msm_vdec_read_input_subcr_params(struct msm_vidc_inst *inst)
 	u32 colour_description_present_flag = 0;
 	u32 video_signal_type_present_flag = 0;
 	enum msm_vidc_colorformat_type output_fmt;
+	int rc = 0;
 
 	core = inst->core;
 
@@ -1416,6 +1454,10 @@ static int msm_vdec_read_input_subcr_params(struct msm_vidc_inst *inst)
 	msm_vidc_update_cap_value(inst, POC, subsc_params.pic_order_cnt, __func__);
 	msm_vidc_update_cap_value(inst, MAX_NUM_REORDER_FRAMES,
 		subsc_params.max_num_reorder_frames, __func__);
+	/* reorder depth is known now, size the ts reorder heap for it */
+	rc = msm_vidc_ts_reorder_reserve(inst);
+	if (rc)
+		return rc;
 	if (subsc_params.bit_depth == BIT_DEPTH_8)
 		msm_vidc_update_cap_value(inst, BIT_DEPTH, BIT_DEPTH_8, __func__);
 	else
@@ -1788,6 +1830,9 @@ int msm_vdec_streamon_output(struct msm_vidc_inst *inst)
 		return -EINVAL;
 	}
 
+	/* DPB create and grow paths must agree for the whole streaming cycle */
+	inst->lazy_dpb_count = msm_vidc_lazy_dpb_count;
+
 	rc = msm_vidc_check_session_supported(inst);
 	if (rc)
 		goto error;
@@ -1929,8 +1974,8 @@ static int msm_vdec_release_eligible_buffers(struct msm_vidc_inst *inst)
 		rc = venus_hfi_release_buffer(inst, ro_buf);
 		if (rc)
 			return rc;
-		ro_buf->attr |= MSM_VIDC_ATTR_PENDING_RELEASE;
-		ro_buf->attr &= ~MSM_VIDC_ATTR_RELEASE_ELIGIBLE;
+		msm_vidc_update_buffer_attr(inst, ro_buf,
+			MSM_VIDC_ATTR_PENDING_RELEASE, MSM_VIDC_ATTR_RELEASE_ELIGIBLE);
 		print_vidc_buffer(VIDC_LOW, "low ", "release buf", inst, ro_buf);
 	}
 
@@ -1942,47 +1987,24 @@ static int msm_vdec_release_nonref_buffers(struct msm_vidc_inst *inst)
 	int rc = 0;
 	u32 fw_ro_count = 0, nonref_ro_count = 0;
 	struct msm_vidc_buffer *ro_buf;
-	int i = 0;
-	bool found = false;
-
-	/* count read_only buffers which are not pending release in read_only list */
-	list_for_each_entry(ro_buf, &inst->buffers.read_only.list, list) {
-		if (!(ro_buf->attr & MSM_VIDC_ATTR_READ_ONLY))
-			continue;
-		if (ro_buf->attr & MSM_VIDC_ATTR_PENDING_RELEASE)
-			continue;
-		fw_ro_count++;
-	}
-
-	if (fw_ro_count <= MAX_DPB_COUNT)
-		return 0;
 
 	/*
-	 * Mark those read only buffers present in read_only list as
-	 * non-reference if that buffer is not part of dpb_list_payload.
-	 * count such non-ref read only buffers as nonref_ro_count.
-	 * dpb_list_payload details:
-	 * payload[0-1]           : 64 bits base_address of DPB-1
-	 * payload[2]             : 32 bits addr_offset  of DPB-1
-	 * payload[3]             : 32 bits data_offset  of DPB-1
+	 * count read_only buffers which are not pending release in read_only
+	 * list, and among those the non-reference ones i.e. not part of the
+	 * last dpb list (dpb_ref is refreshed whenever firmware sends it).
 	 */
 	list_for_each_entry(ro_buf, &inst->buffers.read_only.list, list) {
-		found = false;
 		if (!(ro_buf->attr & MSM_VIDC_ATTR_READ_ONLY))
 			continue;
 		if (ro_buf->attr & MSM_VIDC_ATTR_PENDING_RELEASE)
 			continue;
-		for (i = 0; (i + 3) < MAX_DPB_LIST_ARRAY_SIZE; i = i + 4) {
-			if (ro_buf->device_addr == inst->dpb_list_payload[i] &&
-				ro_buf->data_offset == inst->dpb_list_payload[i + 3]) {
-				found = true;
-				break;
-			}
-		}
-		if (!found)
+		fw_ro_count++;
+		if (!ro_buf->dpb_ref)
 			nonref_ro_count++;
 	}
 
+	if (fw_ro_count <= MAX_DPB_COUNT)
+		return 0;
 
 	if (nonref_ro_count <= inst->buffers.output.min_count)
 		return 0;
@@ -1992,20 +2014,12 @@ static int msm_vdec_release_nonref_buffers(struct msm_vidc_inst *inst)
 
 	/* release the eligible buffers as per above condition */
 	list_for_each_entry(ro_buf, &inst->buffers.read_only.list, list) {
-		found = false;
 		if (!(ro_buf->attr & MSM_VIDC_ATTR_READ_ONLY))
 			continue;
 		if (ro_buf->attr & MSM_VIDC_ATTR_PENDING_RELEASE)
 			continue;
-		for (i = 0; (i + 3) < MAX_DPB_LIST_ARRAY_SIZE; i = i + 4) {
-			if (ro_buf->device_addr == inst->dpb_list_payload[i] &&
-				ro_buf->data_offset == inst->dpb_list_payload[i + 3]) {
-				found = true;
-				break;
-			}
-		}
-		if (!found) {
-			ro_buf->attr |= MSM_VIDC_ATTR_PENDING_RELEASE;
+		if (!ro_buf->dpb_ref) {
+			msm_vidc_update_buffer_attr(inst, ro_buf, MSM_VIDC_ATTR_PENDING_RELEASE, 0);
 			print_vidc_buffer(VIDC_LOW, "low ", "release buf", inst, ro_buf);
 			rc = venus_hfi_release_buffer(inst, ro_buf);
 			if (rc)
@@ -2016,6 +2030,101 @@ static int msm_vdec_release_nonref_buffers(struct msm_vidc_inst *inst)
 	return rc;
 }
 
+static u32 msm_vdec_dpb_buffer_count(struct msm_vidc_buffers *buffers)
+{
+	struct msm_vidc_buffer *buffer;
+	u32 count = 0;
+
+	list_for_each_entry(buffer, &buffers->list, list)
+		count++;
+
+	return count;
+}
+
+/*
+ * Grows the DPB list to count buffers, never beyond the min_count
+ * firmware needs, and queues the new ones.
+ */
+static int msm_vdec_alloc_and_queue_dpb_buffers(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffers *buffers, u32 count)
+{
+	int i, cur_min_count = 0, rc = 0;
+
+	/* get current min_count */
+	cur_min_count = msm_vdec_dpb_buffer_count(buffers);
+
+	/* skip alloc and queue */
+	count = min(count, buffers->min_count);
+	if (cur_min_count >= count)
+		return 0;
+
+	i_vpr_h(inst, "%s: dpb buffer count increased from %u -> %u\n",
+		__func__, cur_min_count, count);
+
+	/* allocate additional DPB buffers */
+	for (i = cur_min_count; i < count; i++) {
+		rc = msm_vidc_create_internal_buffer(inst, MSM_VIDC_BUF_DPB, i);
+		if (rc)
+			return rc;
+	}
+
+	/* queue additional DPB buffers */
+	rc = msm_vidc_queue_internal_buffers(inst, MSM_VIDC_BUF_DPB);
+	if (rc)
+		return rc;
+
+	return 0;
+}
+
+static int msm_vdec_alloc_and_queue_additional_dpb_buffers(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_buffers *buffers;
+	u32 count;
+	int rc = 0;
+
+	/* get latest min_count and size */
+	rc = msm_vidc_get_internal_buffers(inst, MSM_VIDC_BUF_DPB);
+	if (rc)
+		return rc;
+
+	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_DPB, __func__);
+	if (!buffers)
+		return -EINVAL;
+
+	count = buffers->min_count;
+	if (inst->lazy_dpb_count)
+		count = max(msm_vdec_dpb_buffer_count(buffers), inst->lazy_dpb_count);
+
+	return msm_vdec_alloc_and_queue_dpb_buffers(inst, buffers, count);
+}
+
+/*
+ * Lazy DPB mode: firmware has no message asking for DPB buffers and
+ * references have to stay backed, so each output buffer queued while
+ * streaming adds one DPB buffer until firmware's min_count is reached.
+ */
+static int msm_vdec_grow_dpb_buffers(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_buffers *buffers;
+	u32 count;
+
+	if (!inst->lazy_dpb_count ||
+		!inst->bufq[OUTPUT_PORT].vb2q->streaming ||
+		is_sub_state(inst, MSM_VIDC_DRC) ||
+		is_sub_state(inst, MSM_VIDC_OUTPUT_PAUSE))
+		return 0;
+
+	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_DPB, __func__);
+	if (!buffers || !buffers->min_count)
+		return 0;
+
+	count = msm_vdec_dpb_buffer_count(buffers);
+	if (!count || count >= buffers->min_count)
+		return 0;
+
+	return msm_vdec_alloc_and_queue_dpb_buffers(inst, buffers, count + 1);
+}
+
 int msm_vdec_qbuf(struct msm_vidc_inst *inst, struct vb2_buffer *vb2)
 {
 	int rc = 0;
@@ -2050,50 +2159,13 @@ int msm_vdec_qbuf(struct msm_vidc_inst *inst, struct vb2_buffer *vb2)
 			rc = msm_vdec_release_nonref_buffers(inst);
 		if (rc)
 			return rc;
-	}
-
-	return rc;
-}
-
-static int msm_vdec_alloc_and_queue_additional_dpb_buffers(struct msm_vidc_inst *inst)
-{
-	struct msm_vidc_buffers *buffers;
-	struct msm_vidc_buffer *buffer = NULL;
-	int i, cur_min_count = 0, rc = 0;
-
-	/* get latest min_count and size */
-	rc = msm_vidc_get_internal_buffers(inst, MSM_VIDC_BUF_DPB);
-	if (rc)
-		return rc;
-
-	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_DPB, __func__);
-	if (!buffers)
-		return -EINVAL;
-
-	/* get current min_count */
-	list_for_each_entry(buffer, &buffers->list, list)
-		cur_min_count++;
-
-	/* skip alloc and queue */
-	if (cur_min_count >= buffers->min_count)
-		return 0;
-
-	i_vpr_h(inst, "%s: dpb buffer count increased from %u -> %u\n",
-		__func__, cur_min_count, buffers->min_count);
 
-	/* allocate additional DPB buffers */
-	for (i = cur_min_count; i < buffers->min_count; i++) {
-		rc = msm_vidc_create_internal_buffer(inst, MSM_VIDC_BUF_DPB, i);
+		rc = msm_vdec_grow_dpb_buffers(inst);
 		if (rc)
 			return rc;
 	}
 
-	/* queue additional DPB buffers */
-	rc = msm_vidc_queue_internal_buffers(inst, MSM_VIDC_BUF_DPB);
-	if (rc)
-		return rc;
-
-	return 0;
+	return rc;
 }
 
 int msm_vdec_stop_cmd(struct msm_vidc_inst *inst)
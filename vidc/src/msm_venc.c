@@ -472,6 +472,7 @@ static int msm_venc_set_input_properties(struct msm_vidc_inst *inst)
 	};
 
 	i_vpr_h(inst, "%s()\n", __func__);
+	venus_hfi_session_prop_batch_begin(inst);
 	for (i = 0; i < ARRAY_SIZE(msm_venc_input_set_prop); i++) {
 		/* set session input properties */
 		for (j = 0; j < ARRAY_SIZE(prop_type_handle_arr); j++) {
@@ -490,6 +491,10 @@ static int msm_venc_set_input_properties(struct msm_vidc_inst *inst)
 	}
 
 exit:
+	if (rc)
+		venus_hfi_session_prop_batch_abort(inst);
+	else
+		rc = venus_hfi_session_prop_batch_end(inst);
 	return rc;
 }
 
@@ -602,12 +607,18 @@ static int msm_venc_create_input_internal_buffers(struct msm_vidc_inst *inst)
 {
 	int i, rc = 0;
 
+	rc = msm_vidc_reserve_internal_arena(inst, msm_venc_input_internal_buffer_type,
+		ARRAY_SIZE(msm_venc_input_internal_buffer_type));
+	if (rc)
+		return rc;
+
 	for (i = 0; i < ARRAY_SIZE(msm_venc_input_internal_buffer_type); i++) {
 		rc = msm_vidc_create_internal_buffers(inst,
 			msm_venc_input_internal_buffer_type[i]);
 		if (rc)
-			return rc;
+			break;
 	}
+	msm_vidc_release_internal_arena(inst);
 
 	return rc;
 }
@@ -644,14 +655,20 @@ static int msm_venc_create_output_internal_buffers(struct msm_vidc_inst *inst)
 {
 	int i, rc = 0;
 
+	rc = msm_vidc_reserve_internal_arena(inst, msm_venc_output_internal_buffer_type,
+		ARRAY_SIZE(msm_venc_output_internal_buffer_type));
+	if (rc)
+		return rc;
+
 	for (i = 0; i < ARRAY_SIZE(msm_venc_output_internal_buffer_type); i++) {
 		rc = msm_vidc_create_internal_buffers(inst,
 			msm_venc_output_internal_buffer_type[i]);
 		if (rc)
-			return rc;
+			break;
 	}
+	msm_vidc_release_internal_arena(inst);
 
-	return 0;
+	return rc;
 }
 
 static int msm_venc_queue_output_internal_buffers(struct msm_vidc_inst *inst)
@@ -1011,15 +1028,18 @@ int msm_venc_streamon_output(struct msm_vidc_inst *inst)
 		return -EINVAL;
 	}
 
+	/* output, v4l2 and internal properties are sent as one batch */
+	venus_hfi_session_prop_batch_begin(inst);
 	rc = msm_venc_set_output_properties(inst);
-	if (rc)
-		goto error;
-
-	rc = msm_vidc_set_v4l2_properties(inst);
-	if (rc)
+	if (!rc)
+		rc = msm_vidc_set_v4l2_properties(inst);
+	if (!rc)
+		rc = msm_venc_set_internal_properties(inst);
+	if (rc) {
+		venus_hfi_session_prop_batch_abort(inst);
 		goto error;
-
-	rc = msm_venc_set_internal_properties(inst);
+	}
+	rc = venus_hfi_session_prop_batch_end(inst);
 	if (rc)
 		goto error;
 
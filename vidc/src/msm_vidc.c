@@ -277,6 +277,11 @@ int msm_vidc_reqbufs(struct msm_vidc_inst *inst, struct v4l2_requestbuffers *b)
 		goto exit;
 	}
 
+	/* buffers released, do not keep their mappings past reqbufs(0) */
+	if (!b->count)
+		msm_vidc_map_cache_flush(inst,
+			v4l2_type_to_driver(b->type, __func__));
+
 exit:
 	return rc;
 }
@@ -413,6 +418,8 @@ int msm_vidc_qbuf(struct msm_vidc_inst *inst, struct media_device *mdev,
 		goto exit;
 	}
 
+	msm_vidc_update_cache_hints(inst, b);
+
 	rc = vb2_qbuf(q, mdev, b);
 	if (rc)
 		i_vpr_e(inst, "%s: failed with %d\n", __func__, rc);
@@ -489,6 +496,8 @@ int msm_vidc_streamoff(struct msm_vidc_inst *inst, enum v4l2_buf_type type)
 		goto exit;
 	}
 
+	msm_vidc_map_cache_flush(inst, v4l2_type_to_driver(type, __func__));
+
 exit:
 	return rc;
 }
@@ -701,7 +710,6 @@ void *msm_vidc_open(struct msm_vidc_core *core, u32 session_type)
 {
 	int rc = 0;
 	struct msm_vidc_inst *inst = NULL;
-	int i = 0;
 
 	d_vpr_h("%s: %s\n", __func__, video_banner);
 
@@ -754,14 +762,18 @@ void *msm_vidc_open(struct msm_vidc_core *core, u32 session_type)
 		goto fail_add_session;
 	}
 
+	rc = msm_vidc_check_core_mem(inst);
+	if (rc)
+		goto fail_pools_init;
+
 	rc = msm_vidc_pools_init(inst);
 	if (rc) {
 		i_vpr_e(inst, "%s: failed to init pool buffers\n", __func__);
 		goto fail_pools_init;
 	}
 	INIT_LIST_HEAD(&inst->caps_list);
-	INIT_LIST_HEAD(&inst->timestamps.list);
-	INIT_LIST_HEAD(&inst->ts_reorder.list);
+	hash_init(inst->ts_reorder.hash);
+	INIT_HLIST_HEAD(&inst->ts_reorder.free);
 	INIT_LIST_HEAD(&inst->buffers.input.list);
 	INIT_LIST_HEAD(&inst->buffers.input_meta.list);
 	INIT_LIST_HEAD(&inst->buffers.output.list);
@@ -789,12 +801,16 @@ void *msm_vidc_open(struct msm_vidc_core *core, u32 session_type)
 	INIT_LIST_HEAD(&inst->firmware_list);
 	INIT_LIST_HEAD(&inst->enc_input_crs);
 	INIT_LIST_HEAD(&inst->dmabuf_tracker);
+	hash_init(inst->dmabuf_hash);
+	hash_init(inst->dpb_set.hash);
+	INIT_LIST_HEAD(&inst->map_cache.list);
+	hash_init(inst->map_cache.hash);
+	INIT_LIST_HEAD(&inst->mem_chunks.list);
 	INIT_LIST_HEAD(&inst->input_timer_list);
 	INIT_LIST_HEAD(&inst->pending_pkts);
 	INIT_LIST_HEAD(&inst->fence_list);
 	INIT_LIST_HEAD(&inst->buffer_stats_list);
-	for (i = 0; i < MAX_SIGNAL; i++)
-		init_completion(&inst->completions[i]);
+	init_completion(&inst->cmds_done);
 
 	inst->workq = create_singlethread_workqueue("workq");
 	if (!inst->workq) {
@@ -10,6 +10,7 @@
 #include "msm_vidc_control.h"
 #include "msm_vidc_platform.h"
 #include "msm_vidc_internal.h"
+#include "venus_hfi.h"
 
 extern struct msm_vidc_core *g_core;
 
@@ -1068,12 +1069,17 @@ int msm_vidc_set_v4l2_properties(struct msm_vidc_inst *inst)
 
 	i_vpr_h(inst, "%s()\n", __func__);
 
-	/* set all caps from caps_list */
+	/* set all caps from caps_list, sent to firmware as one batch */
+	venus_hfi_session_prop_batch_begin(inst);
 	list_for_each_entry_safe(entry, temp, &inst->caps_list, list) {
 		rc = msm_vidc_set_cap(inst, entry->cap_id, __func__);
 		if (rc)
-			return rc;
+			break;
 	}
+	if (rc)
+		venus_hfi_session_prop_batch_abort(inst);
+	else
+		rc = venus_hfi_session_prop_batch_end(inst);
 
 	return rc;
 }
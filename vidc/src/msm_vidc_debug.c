@@ -225,6 +225,75 @@ EXPORT_SYMBOL(msm_vidc_fw_dump);
 unsigned int msm_vidc_enable_bugon = !1;
 EXPORT_SYMBOL(msm_vidc_enable_bugon);
 
+/*
+ * Number of buffer packets announced to firmware with a single doorbell,
+ * 1 raises the interrupt for every packet. Deferred packets are flushed
+ * after msm_vidc_doorbell_delay_us at the latest.
+ */
+unsigned int msm_vidc_doorbell_batch = 1;
+unsigned int msm_vidc_doorbell_delay_us = 100;
+
+/*
+ * Time and message budget for which the response handler keeps polling
+ * the msg queue with firmware interrupts masked, 0 disables polling.
+ */
+unsigned int msm_vidc_poll_time_us;
+unsigned int msm_vidc_poll_budget = 64;
+
+/*
+ * Number of command packets parked on the host while the cmd queue is
+ * full, 0 fails writes to a full queue right away.
+ */
+unsigned int msm_vidc_cmdq_backlog_max = 128;
+
+/*
+ * IOVA budget per session for mappings kept alive after vb2 lets go of
+ * a dmabuf, 0 unmaps dmabufs right away. Metadata mappings are kept
+ * regardless.
+ */
+unsigned int msm_vidc_map_cache_mb;
+
+/*
+ * Size cap of the core wide cache of internal buffers freed by closed
+ * sessions, 0 disables the cache.
+ */
+unsigned int msm_vidc_mem_cache_mb;
+
+/*
+ * Number of decoder DPB buffers allocated at streamon, the rest is added
+ * one per queued output buffer up to the firmware count. 0 allocates all
+ * of them at streamon.
+ */
+unsigned int msm_vidc_lazy_dpb_count;
+
+/*
+ * Core wide cap on session owned memory, checked at session open and
+ * streamon. 0 disables the check.
+ */
+unsigned int msm_vidc_mem_budget_mb;
+
+/*
+ * Size of the chunks internal buffers up to that size are carved out of,
+ * so that they share one IOMMU mapping per chunk. 0 allocates each
+ * internal buffer on its own.
+ */
+unsigned int msm_vidc_internal_chunk_kb;
+
+/*
+ * Reserve one IOVA range per region for the internal buffers created at
+ * each streamon and bump allocate them out of it.
+ */
+unsigned int msm_vidc_internal_arena;
+
+/*
+ * Cross check the per attribute buffer counters against the buffer lists
+ * whenever they are read, mismatches are logged and resynced.
+ */
+unsigned int msm_vidc_check_attr_count;
+
+/* buffer processing latency of the sim variant's firmware model */
+unsigned int msm_vidc_sim_latency_us = 5000;
+
 #define MAX_DBG_BUF_SIZE 4096
 
 struct core_inst_pair {
@@ -289,6 +358,7 @@ static ssize_t core_info_read(struct file *file, char __user *buf,
 	size_t count, loff_t *ppos)
 {
 	struct msm_vidc_core *core = file->private_data;
+	struct context_bank_info *cb;
 	char *cur, *end, *dbuf = NULL;
 	ssize_t len = 0;
 
@@ -313,6 +383,34 @@ static ssize_t core_info_read(struct file *file, char __user *buf,
 	cur += write_str(cur, end - cur,
 		"register_base: 0x%x\n", core->resource->register_base_addr);
 	cur += write_str(cur, end - cur, "irq: %u\n", core->resource->irq);
+	cur += write_str(cur, end - cur,
+		"doorbells raised: %llu\n", core->doorbell_raised);
+	cur += write_str(cur, end - cur,
+		"doorbells deferred: %llu\n", core->doorbell_deferred);
+	cur += write_str(cur, end - cur,
+		"interrupts: %llu\n", core->intr_count);
+	cur += write_str(cur, end - cur,
+		"messages: %llu\n", core->msg_count);
+	cur += write_str(cur, end - cur,
+		"msgq polls: %llu\n", core->poll_count);
+	cur += write_str(cur, end - cur,
+		"cmdq backlog: %u parked: %llu\n",
+		core->cmdq_backlog_count, core->cmdq_parked);
+	cur += write_str(cur, end - cur,
+		"internal mem cache: %u bufs, %llu bytes, hits %llu, misses %llu, evictions %llu\n",
+		core->mem_cache.count, core->mem_cache.size, core->mem_cache.hits,
+		core->mem_cache.misses, core->mem_cache.evictions);
+	cur += write_str(cur, end - cur, "session memory: %lld bytes, budget %u MB\n",
+		atomic64_read(&core->mem_usage), msm_vidc_mem_budget_mb);
+	venus_hfi_for_each_context_bank(core, cb)
+		cur += write_str(cur, end - cur, "iova %s: %lld bytes\n",
+			cb->name, atomic64_read(&cb->iova_size));
+	cur += write_str(cur, end - cur,
+		"fw log messages: %llu dropped: %llu\n",
+		core->dbg_msg_count, core->dbg_dropped);
+	if (core->intr_count)
+		cur += write_str(cur, end - cur, "messages per interrupt: %llu\n",
+			div64_u64(core->msg_count, core->intr_count));
 
 	len = simple_read_from_buffer(buf, count, ppos,
 		dbuf, cur - dbuf);
@@ -326,6 +424,102 @@ static const struct file_operations core_info_fops = {
 	.read = core_info_read,
 };
 
+static u32 write_queue_stats(char *cur, char *end, const char *name,
+	struct msm_vidc_iface_q_info *q_info, ktime_t now)
+{
+	struct msm_vidc_iface_q_stats *stats = &q_info->stats;
+	u32 q_size = q_info->q_array.mem_size >> 2;
+	u64 pps = 0, bps = 0;
+	s64 elapsed_us;
+	char *start = cur;
+
+	/* rates are averaged over the time since the previous read */
+	elapsed_us = ktime_us_delta(now, stats->sample_time);
+	if (stats->sample_time && elapsed_us > 0) {
+		pps = div64_u64((stats->packets - stats->sample_packets) *
+			USEC_PER_SEC, elapsed_us);
+		bps = div64_u64((stats->bytes - stats->sample_bytes) *
+			USEC_PER_SEC, elapsed_us);
+	}
+	stats->sample_packets = stats->packets;
+	stats->sample_bytes = stats->bytes;
+	stats->sample_time = now;
+
+	cur += write_str(cur, end - cur,
+		"%s: packets %llu bytes %llu rate %llu pkt/s %llu B/s\n",
+		name, stats->packets, stats->bytes, pps, bps);
+	cur += write_str(cur, end - cur,
+		"%s: max used %u/%u words full %u tx_req toggles %u rx_req toggles %u\n",
+		name, stats->max_used_words, q_size, stats->full_count,
+		stats->tx_req_toggles, stats->rx_req_toggles);
+
+	return cur - start;
+}
+
+static ssize_t hfi_queues_read(struct file *file, char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct msm_vidc_core *core = file->private_data;
+	struct msm_vidc_hfi_latency *lat;
+	u64 hist[HFI_LATENCY_BUCKETS];
+	u64 lat_count, lat_total;
+	u32 lat_max, i;
+	char *cur, *end, *dbuf = NULL;
+	ktime_t now = ktime_get();
+	ssize_t len = 0;
+
+	if (!core) {
+		d_vpr_e("%s: invalid params %pK\n", __func__, core);
+		return 0;
+	}
+
+	dbuf = vzalloc(MAX_DBG_BUF_SIZE);
+	if (!dbuf) {
+		d_vpr_e("%s: allocation failed\n", __func__);
+		return -ENOMEM;
+	}
+
+	cur = dbuf;
+	end = cur + MAX_DBG_BUF_SIZE;
+
+	cur += write_queue_stats(cur, end, "cmdq",
+		&core->iface_queues[VIDC_IFACEQ_CMDQ_IDX], now);
+	cur += write_queue_stats(cur, end, "msgq",
+		&core->iface_queues[VIDC_IFACEQ_MSGQ_IDX], now);
+	cur += write_queue_stats(cur, end, "dbgq",
+		&core->iface_queues[VIDC_IFACEQ_DBGQ_IDX], now);
+
+	lat = &core->hfi_latency;
+	spin_lock(&lat->lock);
+	memcpy(hist, lat->hist, sizeof(hist));
+	lat_count = lat->count;
+	lat_total = lat->total_us;
+	lat_max = lat->max_us;
+	spin_unlock(&lat->lock);
+
+	cur += write_str(cur, end - cur,
+		"cmd->response latency: count %llu avg %llu us max %u us\n",
+		lat_count, lat_count ? div64_u64(lat_total, lat_count) : 0,
+		lat_max);
+	cur += write_str(cur, end - cur, "  < %6u us: %llu\n", 16, hist[0]);
+	for (i = 1; i < HFI_LATENCY_BUCKETS - 1; i++)
+		cur += write_str(cur, end - cur, "  < %6u us: %llu\n",
+			1 << (i + 4), hist[i]);
+	cur += write_str(cur, end - cur, "  >= %5u us: %llu\n",
+		1 << (HFI_LATENCY_BUCKETS + 2), hist[HFI_LATENCY_BUCKETS - 1]);
+
+	len = simple_read_from_buffer(buf, count, ppos,
+		dbuf, cur - dbuf);
+
+	vfree(dbuf);
+	return len;
+}
+
+static const struct file_operations hfi_queues_fops = {
+	.open = simple_open,
+	.read = hfi_queues_read,
+};
+
 static ssize_t stats_delay_write_ms(struct file *filp, const char __user *buf,
 		size_t count, loff_t *ppos)
 {
@@ -502,6 +696,34 @@ struct dentry *msm_vidc_debugfs_init_drv(void)
 			&msm_vidc_lossless_encode);
 	debugfs_create_u32("enable_bugon", 0644, dir,
 			&msm_vidc_enable_bugon);
+	debugfs_create_u32("doorbell_batch", 0644, dir,
+			&msm_vidc_doorbell_batch);
+	debugfs_create_u32("doorbell_delay_us", 0644, dir,
+			&msm_vidc_doorbell_delay_us);
+	debugfs_create_u32("poll_time_us", 0644, dir,
+			&msm_vidc_poll_time_us);
+	debugfs_create_u32("poll_budget", 0644, dir,
+			&msm_vidc_poll_budget);
+	debugfs_create_u32("cmdq_backlog_max", 0644, dir,
+			&msm_vidc_cmdq_backlog_max);
+	debugfs_create_u32("map_cache_mb", 0644, dir,
+			&msm_vidc_map_cache_mb);
+	debugfs_create_u32("mem_cache_mb", 0644, dir,
+			&msm_vidc_mem_cache_mb);
+	debugfs_create_u32("lazy_dpb_count", 0644, dir,
+			&msm_vidc_lazy_dpb_count);
+	debugfs_create_u32("mem_budget_mb", 0644, dir,
+			&msm_vidc_mem_budget_mb);
+	debugfs_create_u32("internal_chunk_kb", 0644, dir,
+			&msm_vidc_internal_chunk_kb);
+	debugfs_create_u32("internal_arena", 0644, dir,
+			&msm_vidc_internal_arena);
+	debugfs_create_u32("check_attr_count", 0644, dir,
+			&msm_vidc_check_attr_count);
+#ifdef CONFIG_MSM_VIDC_SIM
+	debugfs_create_u32("sim_latency_us", 0644, dir,
+			&msm_vidc_sim_latency_us);
+#endif
 
 	return dir;
 
@@ -535,6 +757,10 @@ struct dentry *msm_vidc_debugfs_init_core(struct msm_vidc_core *core)
 		d_vpr_e("debugfs_create_file: fail\n");
 		goto failed_create_dir;
 	}
+	if (!debugfs_create_file("hfi_queues", 0444, dir, core, &hfi_queues_fops)) {
+		d_vpr_e("debugfs_create_file: fail\n");
+		goto failed_create_dir;
+	}
 	if (!debugfs_create_file("trigger_ssr", 0200,
 			dir, core, &ssr_fops)) {
 		d_vpr_e("debugfs_create_file: fail\n");
@@ -644,6 +870,38 @@ static ssize_t inst_info_read(struct file *file, char __user *buf,
 		inst->debug_count.ftb);
 	cur += write_str(cur, end - cur, "FBD Count: %d\n",
 		inst->debug_count.fbd);
+	cur += write_str(cur, end - cur,
+		"map cache: %u maps, %llu bytes (%llu pinned), hits %llu, misses %llu, evictions %llu\n",
+		inst->map_cache.count, inst->map_cache.size,
+		inst->map_cache.pinned_size, inst->map_cache.hits,
+		inst->map_cache.misses, inst->map_cache.evictions);
+	cur += write_str(cur, end - cur,
+		"cache ops: performed %llu (%llu bytes), skipped %llu (%llu bytes)\n",
+		inst->cache_stats.performed, inst->cache_stats.performed_bytes,
+		inst->cache_stats.skipped, inst->cache_stats.skipped_bytes);
+	cur += write_str(cur, end - cur,
+		"memory: total %llu, pool %llu, packet %llu, mapped dmabuf %llu bytes\n",
+		inst->mem_usage.total, inst->mem_usage.pool,
+		inst->mem_usage.packet, inst->mem_usage.dmabuf);
+	cur += write_str(cur, end - cur,
+		"internal chunks: %u, %llu bytes, %llu bytes carved\n",
+		inst->mem_chunks.count, inst->mem_chunks.size, inst->mem_chunks.used);
+	for (i = 0; i < ARRAY_SIZE(inst->mem_usage.internal); i++) {
+		if (!inst->mem_usage.internal[i])
+			continue;
+		cur += write_str(cur, end - cur, "memory: %s %llu bytes\n",
+			buf_name(i), inst->mem_usage.internal[i]);
+	}
+	cur += write_str(cur, end - cur, "-----------Pools---------------\n");
+	for (i = 0; i < MSM_MEM_POOL_MAX; i++) {
+		struct msm_memory_pool *pool = &inst->pool[i];
+
+		cur += write_str(cur, end - cur,
+			"%s: busy %u (peak %u), free %u/%u, allocs %llu, frees %llu, reuse %llu\n",
+			pool->name, pool->busy_count, pool->peak_busy,
+			pool->free_count, pool->max_free, pool->cache_allocs,
+			pool->cache_frees, pool->reuse_count);
+	}
 
 	publish_unreleased_reference(inst, &cur, end);
 	len = simple_read_from_buffer(buf, count, ppos,
@@ -6,6 +6,8 @@
 
 #include <linux/iommu.h>
 #include <linux/workqueue.h>
+#include <linux/dma-buf.h>
+#include <linux/genalloc.h>
 #include "msm_media_info.h"
 
 #include "msm_vidc_driver.h"
@@ -785,6 +787,44 @@ bool res_is_less_than_or_equal_to(u32 width, u32 height,
 		return false;
 }
 
+/*
+ * Records the V4L2_BUF_FLAG_NO_CACHE_CLEAN/INVALIDATE hints of a qbuf on
+ * the driver buffer of that index. vb2 drops them for dmabuf queues, so
+ * they are taken from the ioctl argument before vb2_qbuf(). The client
+ * sets them when the CPU has not written the buffer since its last qbuf,
+ * or will not read what the device writes into it.
+ */
+void msm_vidc_update_cache_hints(struct msm_vidc_inst *inst,
+	struct v4l2_buffer *b)
+{
+	struct msm_vidc_buffers *buffers;
+	struct msm_vidc_buffer *buf;
+
+	buffers = msm_vidc_get_buffers(inst,
+		v4l2_type_to_driver(b->type, __func__), __func__);
+	if (!buffers)
+		return;
+
+	buf = msm_vidc_buffer_by_index(buffers, b->index);
+	if (!buf)
+		return;
+
+	buf->no_cache_clean = !!(b->flags & V4L2_BUF_FLAG_NO_CACHE_CLEAN);
+	buf->no_cache_inval = !!(b->flags & V4L2_BUF_FLAG_NO_CACHE_INVALIDATE);
+}
+
+static void msm_vidc_count_cache_op(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf, bool skipped)
+{
+	if (skipped) {
+		inst->cache_stats.skipped++;
+		inst->cache_stats.skipped_bytes += buf->buffer_size;
+	} else {
+		inst->cache_stats.performed++;
+		inst->cache_stats.performed_bytes += buf->buffer_size;
+	}
+}
+
 int msm_vidc_qbuf_cache_operation(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf)
 {
@@ -815,6 +855,11 @@ int msm_vidc_qbuf_cache_operation(struct msm_vidc_inst *inst,
 	}
 
 	if (buf->dmabuf) {
+		/* same as vb2 does on prepare for NO_CACHE_CLEAN */
+		msm_vidc_count_cache_op(inst, buf, buf->no_cache_clean);
+		if (buf->no_cache_clean)
+			return 0;
+
 		rc = msm_memory_cache_operations(inst, buf->dmabuf, cache_type);
 		if (rc)
 			print_vidc_buffer(VIDC_ERR, "err ", "qbuf cache ops failed", inst, buf);
@@ -858,6 +903,11 @@ int msm_vidc_dqbuf_cache_operation(struct msm_vidc_inst *inst,
 		return 0;
 
 	if (buf->dmabuf) {
+		/* same as vb2 does on finish for NO_CACHE_INVALIDATE */
+		msm_vidc_count_cache_op(inst, buf, buf->no_cache_inval);
+		if (buf->no_cache_inval)
+			return 0;
+
 		rc = msm_memory_cache_operations(inst, buf->dmabuf, cache_type);
 		if (rc)
 			print_vidc_buffer(VIDC_ERR, "err ", "dqbuf cache ops failed", inst, buf);
@@ -866,12 +916,127 @@ int msm_vidc_dqbuf_cache_operation(struct msm_vidc_inst *inst,
 	return rc;
 }
 
-int signal_session_msg_receipt(struct msm_vidc_inst *inst,
-	enum signal_session_response cmd)
+/*
+ * Outstanding session commands are tracked by packet id until firmware
+ * responds, see msm_vidc_wait_for_session_cmd(). Responses which never
+ * come, e.g. for a drain cut short by streamoff, must not wedge the
+ * table, so once it is full the oldest command nobody waits on is
+ * dropped. The id of the latest command is kept in inst->last_cmd_id
+ * for the caller to wait on. Called with inst lock held.
+ */
+void msm_vidc_track_session_cmd(struct msm_vidc_inst *inst, u32 type,
+	u32 port, u32 packet_id)
 {
-	if (cmd < MAX_SIGNAL)
-		complete(&inst->completions[cmd]);
-	return 0;
+	struct msm_vidc_pending_cmd *cmd = NULL, *stale = NULL;
+	bool waiting;
+	u32 i;
+
+	waiting = !completion_done(&inst->cmds_done);
+	for (i = 0; i < MAX_PENDING_CMDS; i++) {
+		cmd = &inst->pending_cmds[(inst->pending_cmd_next + i) %
+					  MAX_PENDING_CMDS];
+		if (!cmd->type)
+			break;
+		if (!stale && !(waiting && cmd->packet_id == inst->wait_cmd_id))
+			stale = cmd;
+		cmd = NULL;
+	}
+	if (!cmd) {
+		i_vpr_l(inst, "%s: dropping stale pkt id %u type %#x\n",
+			__func__, stale->packet_id, stale->type);
+		cmd = stale;
+	}
+
+	cmd->type = type;
+	cmd->port = port;
+	cmd->packet_id = packet_id;
+	inst->pending_cmd_next = (cmd - inst->pending_cmds + 1) % MAX_PENDING_CMDS;
+	inst->last_cmd_id = packet_id;
+}
+
+static bool msm_vidc_session_cmd_pending(struct msm_vidc_inst *inst,
+	u32 packet_id)
+{
+	u32 i;
+
+	for (i = 0; i < MAX_PENDING_CMDS; i++) {
+		if (inst->pending_cmds[i].type &&
+		    inst->pending_cmds[i].packet_id == packet_id)
+			return true;
+	}
+
+	return false;
+}
+
+void msm_vidc_session_cmd_done(struct msm_vidc_inst *inst, u32 type,
+	u32 port, u32 packet_id)
+{
+	struct msm_vidc_pending_cmd *cmd;
+	u32 i;
+
+	for (i = 0; i < MAX_PENDING_CMDS; i++) {
+		cmd = &inst->pending_cmds[i];
+		if (cmd->type && cmd->packet_id == packet_id)
+			goto done;
+	}
+
+	/* firmware which does not echo packet ids acks in order per type/port */
+	for (i = 0; i < MAX_PENDING_CMDS; i++) {
+		cmd = &inst->pending_cmds[(inst->pending_cmd_next + i) %
+					  MAX_PENDING_CMDS];
+		if (cmd->type == type && cmd->port == port)
+			goto done;
+	}
+
+	return;
+
+done:
+	if (cmd->packet_id == inst->wait_cmd_id)
+		complete(&inst->cmds_done);
+	cmd->type = 0;
+}
+
+/*
+ * Waits until firmware responded to the session command @packet_id. On
+ * timeout the core is torn down through msm_vidc_inst_timeout(), which
+ * is called without inst lock as core deinit handles every session.
+ */
+int msm_vidc_wait_for_session_cmd(struct msm_vidc_inst *inst, u32 packet_id,
+	const char *func)
+{
+	struct msm_vidc_core *core = inst->core;
+	int rc = 0;
+
+	if (!msm_vidc_session_cmd_pending(inst, packet_id))
+		return 0;
+
+	/* commands of an ongoing burst must reach firmware before waiting */
+	if (inst->hfi_burst)
+		venus_hfi_session_burst_flush(inst);
+
+	/* still under inst lock, so the response cannot be missed */
+	inst->wait_cmd_id = packet_id;
+	reinit_completion(&inst->cmds_done);
+
+	i_vpr_h(inst, "%s: wait on pkt id %u for time: %d ms\n", func,
+		packet_id, core->capabilities[HW_RESPONSE_TIMEOUT].value);
+	inst_unlock(inst, func);
+	rc = wait_for_completion_timeout(&inst->cmds_done,
+			msecs_to_jiffies(
+			core->capabilities[HW_RESPONSE_TIMEOUT].value));
+	if (!rc) {
+		i_vpr_e(inst, "%s: pkt id %u timed out\n", func, packet_id);
+		rc = -ETIMEDOUT;
+		msm_vidc_inst_timeout(inst);
+	} else {
+		rc = 0;
+	}
+	inst_lock(inst, func);
+
+	if (rc)
+		memset(inst->pending_cmds, 0, sizeof(inst->pending_cmds));
+
+	return rc;
 }
 
 bool msm_vidc_allow_metadata_delivery(struct msm_vidc_inst *inst, u32 cap_id,
@@ -1323,12 +1488,12 @@ int msm_vidc_process_streamon_output(struct msm_vidc_inst *inst)
 }
 
 int msm_vidc_process_stop_done(struct msm_vidc_inst *inst,
-		enum signal_session_response signal_type)
+		enum msm_vidc_port_type port)
 {
 	int rc = 0;
 	enum msm_vidc_sub_state set_sub_state = MSM_VIDC_SUB_STATE_NONE;
 
-	if (signal_type == SIGNAL_CMD_STOP_INPUT) {
+	if (port == INPUT_PORT) {
 		set_sub_state = MSM_VIDC_INPUT_PAUSE;
 		/*
 		 * FW is expected to return DRC LAST flag before input
@@ -1350,7 +1515,7 @@ int msm_vidc_process_stop_done(struct msm_vidc_inst *inst,
 			i_vpr_e(inst, "%s: drain last flag pkt not received\n", __func__);
 			msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
 		}
-	} else if (signal_type == SIGNAL_CMD_STOP_OUTPUT) {
+	} else if (port == OUTPUT_PORT) {
 		set_sub_state = MSM_VIDC_OUTPUT_PAUSE;
 	}
 
@@ -1358,7 +1523,6 @@ int msm_vidc_process_stop_done(struct msm_vidc_inst *inst,
 	if (rc)
 		return rc;
 
-	signal_session_msg_receipt(inst, signal_type);
 	return rc;
 }
 
@@ -1587,12 +1751,59 @@ int msm_vidc_get_fps(struct msm_vidc_inst *inst)
 	return fps;
 }
 
+/*
+ * Single place where buffer attributes change, so that the per attribute
+ * counters of the index addressed client buffers stay in sync with attr.
+ */
+void msm_vidc_update_buffer_attr(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf, u32 set, u32 clear)
+{
+	struct msm_vidc_buffers *buffers;
+	unsigned long changed;
+	u32 old = buf->attr;
+	int bit;
+
+	buf->attr = (old & ~clear) | set;
+	changed = old ^ buf->attr;
+	if (!changed)
+		return;
+
+	/* read_only and internal buffers are not counted */
+	buffers = msm_vidc_get_buffers(inst, buf->type, __func__);
+	if (!buffers || msm_vidc_buffer_by_index(buffers, buf->index) != buf)
+		return;
+
+	for_each_set_bit(bit, &changed, MSM_VIDC_ATTR_COUNT) {
+		if (buf->attr & BIT(bit))
+			buffers->attr_count[bit]++;
+		else
+			buffers->attr_count[bit]--;
+	}
+}
+
+static void msm_vidc_verify_attr_count(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffers *buffers, u32 bit)
+{
+	struct msm_vidc_buffer *vbuf;
+	u32 count = 0;
+
+	list_for_each_entry(vbuf, &buffers->list, list) {
+		if (vbuf->attr & BIT(bit))
+			count++;
+	}
+
+	if (count != buffers->attr_count[bit]) {
+		i_vpr_e(inst, "%s: attr %#lx count %u, expected %u\n",
+			__func__, BIT(bit), buffers->attr_count[bit], count);
+		buffers->attr_count[bit] = count;
+	}
+}
+
 int msm_vidc_num_buffers(struct msm_vidc_inst *inst,
 		enum msm_vidc_buffer_type type, enum msm_vidc_buffer_attributes attr)
 {
-	int count = 0;
-	struct msm_vidc_buffer *vbuf;
 	struct msm_vidc_buffers *buffers;
+	u32 bit;
 
 	if (is_output_buffer(type)) {
 		buffers = &inst->buffers.output;
@@ -1601,18 +1812,20 @@ int msm_vidc_num_buffers(struct msm_vidc_inst *inst,
 	} else {
 		i_vpr_e(inst, "%s: invalid buffer type %#x\n",
 				__func__, type);
-		return count;
+		return 0;
 	}
 
-	list_for_each_entry(vbuf, &buffers->list, list) {
-		if (vbuf->type != type)
-			continue;
-		if (!(vbuf->attr & attr))
-			continue;
-		count++;
+	if (!attr || (attr & (attr - 1))) {
+		i_vpr_e(inst, "%s: invalid attr %#x\n", __func__, attr);
+		return 0;
 	}
+	bit = __ffs(attr);
+
+	/* walks the list, for debugging counter drift only */
+	if (msm_vidc_check_attr_count)
+		msm_vidc_verify_attr_count(inst, buffers, bit);
 
-	return count;
+	return buffers->attr_count[bit];
 }
 
 int vb2_buffer_to_driver(struct vb2_buffer *vb2,
@@ -1633,7 +1846,6 @@ int vb2_buffer_to_driver(struct vb2_buffer *vb2,
 	buf->buffer_size = vb2->planes[0].length;
 	buf->timestamp = vb2->timestamp;
 	buf->flags = vbuf->flags;
-	buf->attr = 0;
 	buf->fence_id = 0;
 
 	return rc;
@@ -1662,12 +1874,12 @@ static int msm_vidc_process_readonly_buffers(struct msm_vidc_inst *inst,
 		if (ro_buf->attr & MSM_VIDC_ATTR_READ_ONLY &&
 			!(ro_buf->attr & MSM_VIDC_ATTR_PENDING_RELEASE)) {
 			/* add READ_ONLY to the buffer going to the firmware */
-			buf->attr |= MSM_VIDC_ATTR_READ_ONLY;
+			msm_vidc_update_buffer_attr(inst, buf, MSM_VIDC_ATTR_READ_ONLY, 0);
 			/*
 			 * remove READ_ONLY on the read_only list buffer so that
 			 * it will get removed from the read_only list below
 			 */
-			ro_buf->attr &= ~MSM_VIDC_ATTR_READ_ONLY;
+			msm_vidc_update_buffer_attr(inst, ro_buf, 0, MSM_VIDC_ATTR_READ_ONLY);
 			break;
 		}
 	}
@@ -1681,8 +1893,7 @@ static int msm_vidc_process_readonly_buffers(struct msm_vidc_inst *inst,
 		print_vidc_buffer(VIDC_LOW, "low ", "ro buf removed", inst, ro_buf);
 		/* unmap the buffer if driver holds mapping */
 		if (ro_buf->sg_table && ro_buf->attach) {
-			call_mem_op(core, dma_buf_unmap_attachment, core,
-				ro_buf->attach, ro_buf->sg_table);
+			msm_vidc_unmap_dmabuf(inst, ro_buf->attach, ro_buf->sg_table);
 			call_mem_op(core, dma_buf_detach, core,
 				ro_buf->dmabuf, ro_buf->attach);
 			ro_buf->sg_table = NULL;
@@ -1704,9 +1915,8 @@ static int msm_vidc_process_readonly_buffers(struct msm_vidc_inst *inst,
 int msm_vidc_set_auto_framerate(struct msm_vidc_inst *inst, u64 timestamp)
 {
 	struct msm_vidc_core *core;
-	struct msm_vidc_timestamp *ts;
-	struct msm_vidc_timestamp *prev = NULL;
-	u32 counter = 0, prev_fr = 0, curr_fr = 0;
+	struct msm_vidc_ts_window *win = &inst->timestamps;
+	u32 prev_fr = 0, curr_fr = 0, i;
 	u64 time_us = 0;
 	int rc = 0;
 
@@ -1720,20 +1930,16 @@ int msm_vidc_set_auto_framerate(struct msm_vidc_inst *inst, u64 timestamp)
 	if (rc)
 		goto exit;
 
-	list_for_each_entry(ts, &inst->timestamps.list, sort.list) {
-		if (prev) {
-			time_us = ts->sort.val - prev->sort.val;
-			prev_fr = curr_fr;
-			curr_fr = time_us ? DIV64_U64_ROUND_CLOSEST(USEC_PER_SEC, time_us) << 16 :
-					inst->auto_framerate;
-			if (curr_fr > inst->capabilities[FRAME_RATE].max)
-				curr_fr = inst->capabilities[FRAME_RATE].max;
-		}
-		prev = ts;
-		counter++;
+	for (i = 1; i < win->count; i++) {
+		time_us = win->sorted[i] - win->sorted[i - 1];
+		prev_fr = curr_fr;
+		curr_fr = time_us ? DIV64_U64_ROUND_CLOSEST(USEC_PER_SEC, time_us) << 16 :
+				inst->auto_framerate;
+		if (curr_fr > inst->capabilities[FRAME_RATE].max)
+			curr_fr = inst->capabilities[FRAME_RATE].max;
 	}
 
-	if (counter < ENC_FPS_WINDOW)
+	if (win->count < ENC_FPS_WINDOW)
 		goto exit;
 
 	/* if framerate changed and stable for 2 frames, set to firmware */
@@ -1834,179 +2040,221 @@ int msm_vidc_get_operating_rate(struct msm_vidc_inst *inst)
 	return inst->capabilities[OPERATING_RATE].value >> 16;
 }
 
-static int msm_vidc_insert_sort(struct list_head *head,
-	struct msm_vidc_sort *entry)
+int msm_vidc_flush_ts(struct msm_vidc_inst *inst)
 {
-	struct msm_vidc_sort *first, *node;
-	struct msm_vidc_sort *prev = NULL;
-	bool is_inserted = false;
+	struct msm_vidc_ts_window *win = &inst->timestamps;
 
-	if (!head || !entry) {
-		d_vpr_e("%s: invalid params\n", __func__);
-		return -EINVAL;
-	}
+	i_vpr_l(inst, "%s: flushing %u timestamps\n", __func__, win->count);
+	win->head = 0;
+	win->count = 0;
 
-	if (list_empty(head)) {
-		list_add(&entry->list, head);
-		return 0;
-	}
+	return 0;
+}
 
-	first = list_first_entry(head, struct msm_vidc_sort, list);
-	if (entry->val < first->val) {
-		list_add(&entry->list, head);
-		return 0;
-	}
+int msm_vidc_update_timestamp_rate(struct msm_vidc_inst *inst, u64 timestamp)
+{
+	struct msm_vidc_ts_window *win = &inst->timestamps;
+	u32 window_size = 0;
+	u32 timestamp_rate = 0;
+	u64 ts_ms = 0;
+	u32 counter = 0;
+	u32 i, pos;
+	s64 val = timestamp;
 
-	list_for_each_entry(node, head, list) {
-		if (prev &&
-			entry->val >= prev->val && entry->val <= node->val) {
-			list_add(&entry->list, &prev->list);
-			is_inserted = true;
-			break;
+	if (is_encode_session(inst))
+		window_size = ENC_FPS_WINDOW;
+	else
+		window_size = DEC_FPS_WINDOW;
+
+	/* keep sliding window: drop the oldest timestamp once full */
+	if (win->count >= window_size) {
+		for (pos = 0; pos < win->count; pos++) {
+			if (win->sorted[pos] == win->ring[win->head])
+				break;
 		}
-		prev = node;
+		if (pos == win->count) {
+			i_vpr_e(inst, "%s: oldest ts %lld not in window\n",
+				__func__, win->ring[win->head]);
+			return -EINVAL;
+		}
+		win->count--;
+		memmove(&win->sorted[pos], &win->sorted[pos + 1],
+			(win->count - pos) * sizeof(win->sorted[0]));
+		win->head = (win->head + 1) % MAX_FPS_WINDOW;
 	}
 
-	if (!is_inserted && prev)
-		list_add(&entry->list, &prev->list);
+	/* insert after equal timestamps, into both arrival and sorted order */
+	win->ring[(win->head + win->count) % MAX_FPS_WINDOW] = val;
+	for (pos = win->count; pos && win->sorted[pos - 1] > val; pos--)
+		win->sorted[pos] = win->sorted[pos - 1];
+	win->sorted[pos] = val;
+	win->count++;
+
+	/* Calculate timestamp rate */
+	for (i = 1; i < win->count; i++) {
+		if (win->sorted[i] == win->sorted[i - 1])
+			continue;
+		ts_ms += div_u64(win->sorted[i] - win->sorted[i - 1], 1000000);
+		counter++;
+	}
+	if (ts_ms)
+		timestamp_rate = (u32)div_u64((u64)counter * 1000, ts_ms);
+
+	msm_vidc_update_cap_value(inst, TIMESTAMP_RATE, timestamp_rate << 16, __func__);
 
 	return 0;
 }
 
-static struct msm_vidc_timestamp *msm_vidc_get_least_rank_ts(struct msm_vidc_inst *inst)
+static void msm_vidc_ts_heap_swap(struct msm_vidc_ts_heap *h, u32 a, u32 b)
 {
-	struct msm_vidc_timestamp *ts, *final = NULL;
-	u64 least_rank = INT_MAX;
+	swap(h->heap[a], h->heap[b]);
+	h->heap[a]->pos = a;
+	h->heap[b]->pos = b;
+}
 
-	list_for_each_entry(ts, &inst->timestamps.list, sort.list) {
-		if (ts->rank < least_rank) {
-			least_rank = ts->rank;
-			final = ts;
-		}
-	}
+static void msm_vidc_ts_heap_up(struct msm_vidc_ts_heap *h, u32 pos)
+{
+	u32 parent;
 
-	return final;
+	while (pos) {
+		parent = (pos - 1) / 2;
+		if (h->heap[parent]->val <= h->heap[pos]->val)
+			break;
+		msm_vidc_ts_heap_swap(h, pos, parent);
+		pos = parent;
+	}
 }
 
-int msm_vidc_flush_ts(struct msm_vidc_inst *inst)
+static void msm_vidc_ts_heap_down(struct msm_vidc_ts_heap *h, u32 pos)
 {
-	struct msm_vidc_timestamp *temp, *ts = NULL;
-	struct msm_vidc_core *core;
-
-	core = inst->core;
+	u32 child;
 
-	list_for_each_entry_safe(ts, temp, &inst->timestamps.list, sort.list) {
-		i_vpr_l(inst, "%s: flushing ts: val %llu, rank %llu\n",
-			__func__, ts->sort.val, ts->rank);
-		list_del(&ts->sort.list);
-		msm_vidc_pool_free(inst, ts);
+	for (;;) {
+		child = 2 * pos + 1;
+		if (child >= h->count)
+			break;
+		if (child + 1 < h->count &&
+			h->heap[child + 1]->val < h->heap[child]->val)
+			child++;
+		if (h->heap[pos]->val <= h->heap[child]->val)
+			break;
+		msm_vidc_ts_heap_swap(h, pos, child);
+		pos = child;
 	}
-	inst->timestamps.count = 0;
-	inst->timestamps.rank = 0;
+}
 
-	return 0;
+static void msm_vidc_ts_heap_del(struct msm_vidc_ts_heap *h,
+	struct msm_vidc_ts_entry *entry)
+{
+	u32 pos = entry->pos;
+
+	hash_del(&entry->hnode);
+	hlist_add_head(&entry->hnode, &h->free);
+
+	/* move the last entry into the hole and restore heap order */
+	h->count--;
+	if (pos == h->count)
+		return;
+	h->heap[pos] = h->heap[h->count];
+	h->heap[pos]->pos = pos;
+	msm_vidc_ts_heap_up(h, pos);
+	msm_vidc_ts_heap_down(h, pos);
 }
 
-int msm_vidc_update_timestamp_rate(struct msm_vidc_inst *inst, u64 timestamp)
+static int msm_vidc_ts_reorder_resize(struct msm_vidc_inst *inst, u32 size)
 {
-	struct msm_vidc_timestamp *ts, *prev = NULL;
-	struct msm_vidc_core *core;
-	int rc = 0;
-	u32 window_size = 0;
-	u32 timestamp_rate = 0;
-	u64 ts_ms = 0;
-	u32 counter = 0;
+	struct msm_vidc_ts_heap *h = &inst->ts_reorder;
+	struct msm_vidc_ts_entry *entries, **heap;
+	u32 i;
 
-	core = inst->core;
+	if (size <= h->size)
+		return 0;
 
-	ts = msm_vidc_pool_alloc(inst, MSM_MEM_POOL_TIMESTAMP);
-	if (!ts) {
-		i_vpr_e(inst, "%s: ts alloc failed\n", __func__);
+	entries = kcalloc(size, sizeof(*entries), GFP_KERNEL);
+	heap = kcalloc(size, sizeof(*heap), GFP_KERNEL);
+	if (!entries || !heap) {
+		i_vpr_e(inst, "%s: alloc failed, size %u\n", __func__, size);
+		kfree(entries);
+		kfree(heap);
 		return -ENOMEM;
 	}
 
-	INIT_LIST_HEAD(&ts->sort.list);
-	ts->sort.val = timestamp;
-	ts->rank = inst->timestamps.rank++;
-	rc = msm_vidc_insert_sort(&inst->timestamps.list, &ts->sort);
-	if (rc)
-		return rc;
-	inst->timestamps.count++;
+	/* carry pending timestamps over in heap order, so it stays a heap */
+	hash_init(h->hash);
+	INIT_HLIST_HEAD(&h->free);
+	for (i = 0; i < size; i++) {
+		if (i >= h->count) {
+			hlist_add_head(&entries[i].hnode, &h->free);
+			continue;
+		}
+		entries[i].val = h->heap[i]->val;
+		entries[i].pos = i;
+		heap[i] = &entries[i];
+		hash_add(h->hash, &entries[i].hnode, entries[i].val);
+	}
+	kfree(h->entries);
+	kfree(h->heap);
+	h->entries = entries;
+	h->heap = heap;
+	h->size = size;
+	i_vpr_h(inst, "%s: ts reorder size %u, pending %u\n",
+		__func__, h->size, h->count);
 
-	if (is_encode_session(inst))
-		window_size = ENC_FPS_WINDOW;
-	else
-		window_size = DEC_FPS_WINDOW;
+	return 0;
+}
 
-	/* keep sliding window */
-	if (inst->timestamps.count > window_size) {
-		ts = msm_vidc_get_least_rank_ts(inst);
-		if (!ts) {
-			i_vpr_e(inst, "%s: least rank ts is NULL\n", __func__);
-			return -EINVAL;
-		}
-		inst->timestamps.count--;
-		list_del(&ts->sort.list);
-		msm_vidc_pool_free(inst, ts);
-	}
+/*
+ * Timestamps pend from input qbuf until their frame is output, so at most
+ * the input queue plus the frames the bitstream may hold back for reorder.
+ */
+int msm_vidc_ts_reorder_reserve(struct msm_vidc_inst *inst)
+{
+	u32 depth;
 
-	/* Calculate timestamp rate */
-	list_for_each_entry(ts, &inst->timestamps.list, sort.list) {
-		if (prev) {
-			if (ts->sort.val == prev->sort.val)
-				continue;
-			ts_ms += div_u64(ts->sort.val - prev->sort.val, 1000000);
-			counter++;
-		}
-		prev = ts;
-	}
-	if (ts_ms)
-		timestamp_rate = (u32)div_u64((u64)counter * 1000, ts_ms);
+	if (!is_ts_reorder_allowed(inst))
+		return 0;
 
-	msm_vidc_update_cap_value(inst, TIMESTAMP_RATE, timestamp_rate << 16, __func__);
+	depth = inst->capabilities[MAX_NUM_REORDER_FRAMES].value >> 16;
 
-	return 0;
+	return msm_vidc_ts_reorder_resize(inst,
+		inst->buffers.input.actual_count + depth);
 }
 
 int msm_vidc_ts_reorder_insert_timestamp(struct msm_vidc_inst *inst, u64 timestamp)
 {
-	struct msm_vidc_timestamp *ts;
-	struct msm_vidc_core *core;
+	struct msm_vidc_ts_heap *h = &inst->ts_reorder;
+	struct msm_vidc_ts_entry *entry;
 	int rc = 0;
 
-	core = inst->core;
-
-	/* allocate ts from pool */
-	ts = msm_vidc_pool_alloc(inst, MSM_MEM_POOL_TIMESTAMP);
-	if (!ts) {
-		i_vpr_e(inst, "%s: ts alloc failed\n", __func__);
-		return -ENOMEM;
+	/* more pending than reserved for, grow */
+	if (h->count == h->size) {
+		rc = msm_vidc_ts_reorder_resize(inst,
+			max_t(u32, 2 * h->size, MIN_TS_REORDER_SIZE));
+		if (rc)
+			return rc;
 	}
 
-	/* initialize ts node */
-	INIT_LIST_HEAD(&ts->sort.list);
-	ts->sort.val = timestamp;
-	rc = msm_vidc_insert_sort(&inst->ts_reorder.list, &ts->sort);
-	if (rc)
-		return rc;
-	inst->ts_reorder.count++;
+	entry = hlist_entry(h->free.first, struct msm_vidc_ts_entry, hnode);
+	hlist_del(&entry->hnode);
+	entry->val = timestamp;
+	entry->pos = h->count;
+	h->heap[h->count++] = entry;
+	hash_add(h->hash, &entry->hnode, entry->val);
+	msm_vidc_ts_heap_up(h, entry->pos);
 
 	return 0;
 }
 
 int msm_vidc_ts_reorder_remove_timestamp(struct msm_vidc_inst *inst, u64 timestamp)
 {
-	struct msm_vidc_timestamp *ts, *temp;
-	struct msm_vidc_core *core;
-
-	core = inst->core;
+	struct msm_vidc_ts_heap *h = &inst->ts_reorder;
+	struct msm_vidc_ts_entry *entry;
+	s64 val = timestamp;
 
 	/* remove matching node */
-	list_for_each_entry_safe(ts, temp, &inst->ts_reorder.list, sort.list) {
-		if (ts->sort.val == timestamp) {
-			list_del_init(&ts->sort.list);
-			inst->ts_reorder.count--;
-			msm_vidc_pool_free(inst, ts);
+	hash_for_each_possible(h->hash, entry, hnode, val) {
+		if (entry->val == val) {
+			msm_vidc_ts_heap_del(h, entry);
 			break;
 		}
 	}
@@ -2016,45 +2264,33 @@ int msm_vidc_ts_reorder_remove_timestamp(struct msm_vidc_inst *inst, u64 timesta
 
 int msm_vidc_ts_reorder_get_first_timestamp(struct msm_vidc_inst *inst, u64 *timestamp)
 {
-	struct msm_vidc_timestamp *ts;
-	struct msm_vidc_core *core;
-
-	core = inst->core;
+	struct msm_vidc_ts_heap *h = &inst->ts_reorder;
 
-	/* check if list empty */
-	if (list_empty(&inst->ts_reorder.list)) {
+	/* check if heap empty */
+	if (!h->count) {
 		i_vpr_e(inst, "%s: list empty. ts %lld\n", __func__, *timestamp);
 		return -EINVAL;
 	}
 
-	/* get 1st node from reorder list */
-	ts = list_first_entry(&inst->ts_reorder.list,
-		struct msm_vidc_timestamp, sort.list);
-	list_del_init(&ts->sort.list);
-
-	/* copy timestamp */
-	*timestamp = ts->sort.val;
-
-	inst->ts_reorder.count--;
-	msm_vidc_pool_free(inst, ts);
+	/* copy and pop the smallest timestamp */
+	*timestamp = h->heap[0]->val;
+	msm_vidc_ts_heap_del(h, h->heap[0]);
 
 	return 0;
 }
 
 int msm_vidc_ts_reorder_flush(struct msm_vidc_inst *inst)
 {
-	struct msm_vidc_timestamp *temp, *ts = NULL;
-	struct msm_vidc_core *core;
-
-	core = inst->core;
+	struct msm_vidc_ts_heap *h = &inst->ts_reorder;
+	u32 i;
 
 	/* flush all entries */
-	list_for_each_entry_safe(ts, temp, &inst->ts_reorder.list, sort.list) {
-		i_vpr_l(inst, "%s: flushing ts: val %lld\n", __func__, ts->sort.val);
-		list_del(&ts->sort.list);
-		msm_vidc_pool_free(inst, ts);
+	i_vpr_l(inst, "%s: flushing %u ts\n", __func__, h->count);
+	for (i = 0; i < h->count; i++) {
+		hash_del(&h->heap[i]->hnode);
+		hlist_add_head(&h->heap[i]->hnode, &h->free);
 	}
-	inst->ts_reorder.count = 0;
+	h->count = 0;
 
 	return 0;
 }
@@ -2078,8 +2314,8 @@ struct msm_vidc_buffer *msm_vidc_get_driver_buf(struct msm_vidc_inst *inst,
 	if (rc)
 		return NULL;
 
-	/* treat every buffer as deferred buffer initially */
-	buf->attr |= MSM_VIDC_ATTR_DEFERRED;
+	/* drop stale attributes, treat every buffer as deferred initially */
+	msm_vidc_update_buffer_attr(inst, buf, MSM_VIDC_ATTR_DEFERRED, ~0);
 
 	if (is_decode_session(inst) && is_output_buffer(buf->type)) {
 		/* get a reference */
@@ -2109,6 +2345,13 @@ int msm_vidc_allocate_buffers(struct msm_vidc_inst *inst,
 	if (!buffers)
 		return -EINVAL;
 
+	buffers->table = kcalloc(num_buffers, sizeof(*buffers->table), GFP_KERNEL);
+	if (!buffers->table) {
+		i_vpr_e(inst, "%s: table alloc failed\n", __func__);
+		return -ENOMEM;
+	}
+	buffers->table_size = num_buffers;
+
 	for (idx = 0; idx < num_buffers; idx++) {
 		buf = msm_vidc_pool_alloc(inst, MSM_MEM_POOL_BUFFER);
 		if (!buf) {
@@ -2120,6 +2363,7 @@ int msm_vidc_allocate_buffers(struct msm_vidc_inst *inst,
 		buf->type = buf_type;
 		buf->index = idx;
 		buf->region = call_mem_op(core, buffer_region, inst, buf_type);
+		buffers->table[idx] = buf;
 	}
 	i_vpr_h(inst, "%s: allocated %d buffers for type %s\n",
 		__func__, num_buffers, buf_name(buf_type));
@@ -2148,19 +2392,234 @@ int msm_vidc_free_buffers(struct msm_vidc_inst *inst,
 		list_del_init(&buf->list);
 		msm_vidc_pool_free(inst, buf);
 	}
+	kfree(buffers->table);
+	buffers->table = NULL;
+	buffers->table_size = 0;
+	memset(buffers->attr_count, 0, sizeof(buffers->attr_count));
 	i_vpr_h(inst, "%s: freed %d buffers for type %s\n",
 		__func__, buf_count, buf_name(buf_type));
 
 	return rc;
 }
 
+/*
+ * Sizes the session object pools from the negotiated buffer counts, so
+ * that qbuf and the buffer done paths recycle pool objects instead of
+ * allocating them per frame.
+ */
+int msm_vidc_prealloc_pools(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_buffers_info *b = &inst->buffers;
+	u32 input, bufs;
+	int rc = 0;
+
+	input = b->input.actual_count;
+	bufs = input + b->output.actual_count +
+		b->input_meta.actual_count + b->output_meta.actual_count;
+
+	rc = msm_vidc_pool_prealloc(inst, MSM_MEM_POOL_DMABUF, bufs);
+	if (rc)
+		return rc;
+
+	/* decoder read only buffers are tracked with their own nodes */
+	if (is_decode_session(inst))
+		bufs += b->output.actual_count;
+	rc = msm_vidc_pool_prealloc(inst, MSM_MEM_POOL_BUFFER, bufs);
+	if (rc)
+		return rc;
+
+	rc = msm_vidc_ts_reorder_reserve(inst);
+	if (rc)
+		return rc;
+
+	rc = msm_vidc_pool_prealloc(inst, MSM_MEM_POOL_BUF_TIMER, input);
+	if (rc)
+		return rc;
+
+	rc = msm_vidc_pool_prealloc(inst, MSM_MEM_POOL_BUF_STATS, input);
+	if (rc)
+		return rc;
+
+	return rc;
+}
+
+/*
+ * Charges bytes, negative to give them back, to one of the session's
+ * memory usage counters and to the session and core totals.
+ */
+void msm_vidc_mem_account(struct msm_vidc_inst *inst, u64 *counter, s64 bytes)
+{
+	*counter += bytes;
+	inst->mem_usage.total += bytes;
+	atomic64_add(bytes, &inst->core->mem_usage);
+}
+
+struct sg_table *msm_vidc_map_dmabuf(struct msm_vidc_inst *inst,
+	struct dma_buf_attachment *attach)
+{
+	struct msm_vidc_core *core = inst->core;
+	struct sg_table *table;
+
+	table = call_mem_op(core, dma_buf_map_attachment, core, attach);
+	if (table)
+		msm_vidc_mem_account(inst, &inst->mem_usage.dmabuf,
+			attach->dmabuf->size);
+
+	return table;
+}
+
+void msm_vidc_unmap_dmabuf(struct msm_vidc_inst *inst,
+	struct dma_buf_attachment *attach, struct sg_table *table)
+{
+	struct msm_vidc_core *core = inst->core;
+
+	call_mem_op(core, dma_buf_unmap_attachment, core, attach, table);
+	msm_vidc_mem_account(inst, &inst->mem_usage.dmabuf,
+		-(s64)attach->dmabuf->size);
+}
+
+static void msm_vidc_map_cache_del(struct msm_vidc_inst *inst,
+	struct msm_memory_map *map)
+{
+	list_del(&map->list);
+	hash_del(&map->hnode);
+	inst->map_cache.count--;
+	inst->map_cache.size -= map->size;
+	if (map->pinned)
+		inst->map_cache.pinned_size -= map->size;
+}
+
+static void msm_vidc_map_cache_evict(struct msm_vidc_inst *inst,
+	struct msm_memory_map *map)
+{
+	struct msm_vidc_core *core = inst->core;
+
+	msm_vidc_map_cache_del(inst, map);
+	inst->map_cache.evictions++;
+
+	msm_vidc_unmap_dmabuf(inst, map->attach, map->sg_table);
+	call_mem_op(core, dma_buf_detach, core, map->dmabuf, map->attach);
+	dma_buf_put(map->dmabuf);
+	msm_vidc_pool_free(inst, map);
+}
+
+/*
+ * Hands a mapping kept in the map cache over to buf. A NULL dev matches
+ * any device, as on re-map of an attachment vb2 never detached. Returns
+ * true if buf->attach and buf->sg_table were populated from the cache.
+ */
+bool msm_vidc_map_cache_get(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf, struct device *dev)
+{
+	struct msm_memory_map *map;
+
+	hash_for_each_possible(inst->map_cache.hash, map, hnode,
+			(unsigned long)buf->dmabuf) {
+		if (map->dmabuf != buf->dmabuf)
+			continue;
+		if (dev && map->attach->dev != dev)
+			continue;
+
+		buf->attach = map->attach;
+		buf->sg_table = map->sg_table;
+		buf->device_addr = map->device_addr;
+
+		msm_vidc_map_cache_del(inst, map);
+		inst->map_cache.hits++;
+
+		/* vb2 holds its own dmabuf reference while attached */
+		dma_buf_put(map->dmabuf);
+		msm_vidc_pool_free(inst, map);
+		return true;
+	}
+
+	if (msm_vidc_map_cache_mb || is_meta_buffer(buf->type))
+		inst->map_cache.misses++;
+	return false;
+}
+
+/*
+ * Keeps the attachment and mapping of a buffer vb2 is about to unmap,
+ * keyed by its dmabuf, so that queueing the same dmabuf again reuses the
+ * IOVA instead of an iommu map/unmap per frame. The cache holds a dmabuf
+ * reference, it drops mappings least recently parked first once over
+ * the msm_vidc_map_cache_mb budget. Metadata mappings are small and used
+ * every frame, they are pinned: kept whatever the budget until flushed.
+ * Returns true if the cache took ownership of buf->attach and
+ * buf->sg_table.
+ */
+bool msm_vidc_map_cache_put(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf)
+{
+	struct msm_memory_map *map, *dummy;
+	struct dma_buf *dmabuf = buf->dmabuf;
+	u64 budget = (u64)msm_vidc_map_cache_mb * SZ_1M;
+	bool pinned = is_meta_buffer(buf->type);
+
+	if (!dmabuf || !buf->attach || !buf->sg_table)
+		return false;
+	if (!pinned && dmabuf->size > budget)
+		return false;
+
+	map = msm_vidc_pool_alloc(inst, MSM_MEM_POOL_MAP);
+	if (!map)
+		return false;
+
+	get_dma_buf(dmabuf);
+	map->dmabuf = dmabuf;
+	map->attach = buf->attach;
+	map->sg_table = buf->sg_table;
+	map->device_addr = buf->device_addr;
+	map->size = dmabuf->size;
+	map->pinned = pinned;
+	map->type = buf->type;
+	INIT_LIST_HEAD(&map->list);
+	list_add_tail(&map->list, &inst->map_cache.list);
+	hash_add(inst->map_cache.hash, &map->hnode, (unsigned long)dmabuf);
+	inst->map_cache.count++;
+	inst->map_cache.size += map->size;
+	if (pinned)
+		inst->map_cache.pinned_size += map->size;
+
+	buf->attach = NULL;
+	buf->sg_table = NULL;
+	buf->device_addr = 0x0;
+
+	/* release the oldest unpinned mappings until back under the budget */
+	list_for_each_entry_safe(map, dummy, &inst->map_cache.list, list) {
+		if (inst->map_cache.size - inst->map_cache.pinned_size <= budget)
+			break;
+		if (!map->pinned)
+			msm_vidc_map_cache_evict(inst, map);
+	}
+
+	return true;
+}
+
+/*
+ * Drops cached mappings of buffer @type, e.g. once its queue is stopped or
+ * released and the client may reallocate, along with mappings of dmabufs
+ * the client has closed, only the cache holds those. MSM_VIDC_BUF_NONE
+ * drops all.
+ */
+void msm_vidc_map_cache_flush(struct msm_vidc_inst *inst,
+	enum msm_vidc_buffer_type type)
+{
+	struct msm_memory_map *map, *dummy;
+
+	list_for_each_entry_safe(map, dummy, &inst->map_cache.list, list) {
+		if (type == MSM_VIDC_BUF_NONE || map->type == type ||
+			file_count(map->dmabuf->file) == 1)
+			msm_vidc_map_cache_evict(inst, map);
+	}
+}
+
 struct msm_vidc_buffer *msm_vidc_fetch_buffer(struct msm_vidc_inst *inst,
 	struct vb2_buffer *vb2)
 {
 	struct msm_vidc_buffer *buf = NULL;
 	struct msm_vidc_buffers *buffers;
 	enum msm_vidc_buffer_type buf_type;
-	bool found = false;
 
 	buf_type = v4l2_type_to_driver(vb2->type, __func__);
 	if (!buf_type)
@@ -2170,14 +2629,8 @@ struct msm_vidc_buffer *msm_vidc_fetch_buffer(struct msm_vidc_inst *inst,
 	if (!buffers)
 		return NULL;
 
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (buf->index == vb2->index) {
-			found = true;
-			break;
-		}
-	}
-
-	if (!found) {
+	buf = msm_vidc_buffer_by_index(buffers, vb2->index);
+	if (!buf) {
 		i_vpr_e(inst, "%s: buffer not found for index %d for vb2 buffer type %s\n",
 			__func__, vb2->index, v4l2_type_name(vb2->type));
 		return NULL;
@@ -2189,9 +2642,7 @@ struct msm_vidc_buffer *msm_vidc_fetch_buffer(struct msm_vidc_inst *inst,
 struct msm_vidc_buffer *get_meta_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf)
 {
-	struct msm_vidc_buffer *mbuf;
 	struct msm_vidc_buffers *buffers;
-	bool found = false;
 
 	if (is_input_buffer(buf->type)) {
 		buffers = &inst->buffers.input_meta;
@@ -2202,16 +2653,8 @@ struct msm_vidc_buffer *get_meta_buffer(struct msm_vidc_inst *inst,
 			__func__, buf->type);
 		return NULL;
 	}
-	list_for_each_entry(mbuf, &buffers->list, list) {
-		if (mbuf->index == buf->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found)
-		return NULL;
 
-	return mbuf;
+	return msm_vidc_buffer_by_index(buffers, buf->index);
 }
 
 bool msm_vidc_is_super_buffer(struct msm_vidc_inst *inst)
@@ -2572,6 +3015,13 @@ static int msm_vidc_queue_buffer(struct msm_vidc_inst *inst, struct msm_vidc_buf
 	int rc = 0;
 	u32 cr = 0;
 
+	/* firmware is not keeping up, hold the buffer until the backlog drains */
+	if (venus_hfi_session_backlogged(inst)) {
+		print_vidc_buffer(VIDC_LOW, "low ", "qbuf backlogged", inst, buf);
+		inst->backlog_held |= BIT(buf->type);
+		return 0;
+	}
+
 	if (is_encode_session(inst) && is_input_buffer(buf->type)) {
 		cr = inst->capabilities[ENC_IP_CR].value;
 		msm_vidc_update_input_cr(inst, buf->index, cr);
@@ -2613,11 +3063,10 @@ static int msm_vidc_queue_buffer(struct msm_vidc_inst *inst, struct msm_vidc_buf
 	if (rc)
 		return rc;
 
-	buf->attr &= ~MSM_VIDC_ATTR_DEFERRED;
-	buf->attr |= MSM_VIDC_ATTR_QUEUED;
+	msm_vidc_update_buffer_attr(inst, buf, MSM_VIDC_ATTR_QUEUED, MSM_VIDC_ATTR_DEFERRED);
 	if (meta) {
-		meta->attr &= ~MSM_VIDC_ATTR_DEFERRED;
-		meta->attr |= MSM_VIDC_ATTR_QUEUED;
+		msm_vidc_update_buffer_attr(inst, meta,
+			MSM_VIDC_ATTR_QUEUED, MSM_VIDC_ATTR_DEFERRED);
 	}
 
 	/* insert timestamp for ts_reorder enable case */
@@ -2686,10 +3135,41 @@ int msm_vidc_queue_deferred_buffers(struct msm_vidc_inst *inst, enum msm_vidc_bu
 	return 0;
 }
 
+/*
+ * Queues the buffers msm_vidc_queue_buffer() held back while the session
+ * was backlogged, once it no longer is.
+ */
+int msm_vidc_queue_held_buffers(struct msm_vidc_inst *inst)
+{
+	u32 held = inst->backlog_held;
+	int rc = 0;
+
+	if (!held || is_session_error(inst) || venus_hfi_session_backlogged(inst))
+		return 0;
+
+	inst->backlog_held = 0;
+	if (held & BIT(MSM_VIDC_BUF_INPUT)) {
+		rc = msm_vidc_queue_deferred_buffers(inst, MSM_VIDC_BUF_INPUT);
+		if (rc)
+			return rc;
+	}
+	if (held & BIT(MSM_VIDC_BUF_OUTPUT)) {
+		rc = msm_vidc_queue_deferred_buffers(inst, MSM_VIDC_BUF_OUTPUT);
+		if (rc)
+			return rc;
+	}
+
+	return rc;
+}
+
 int msm_vidc_buf_queue(struct msm_vidc_inst *inst, struct msm_vidc_buffer *buf)
 {
 	int rc = 0;
 
+	/* keep the order, the new buffer goes behind the held ones */
+	if (inst->backlog_held & BIT(buf->type))
+		return msm_vidc_queue_held_buffers(inst);
+
 	msm_vidc_scale_power(inst, is_input_buffer(buf->type));
 
 	rc = msm_vidc_queue_buffer(inst, buf);
@@ -2733,6 +3213,420 @@ exit:
 	return rc;
 }
 
+static void msm_vidc_mem_cache_evict(struct msm_vidc_core *core,
+	struct msm_vidc_mem_cache_entry *entry)
+{
+	struct msm_vidc_mem_cache *cache = &core->mem_cache;
+
+	list_del(&entry->list);
+	cache->count--;
+	cache->size -= entry->mem.size;
+	cache->evictions++;
+
+	call_mem_op(core, memory_unmap_free, core, &entry->mem);
+	kfree(entry);
+}
+
+/*
+ * Takes over an internal allocation a session is done with, instead of
+ * unmapping and freeing it. Secure allocations are not taken, the CPU
+ * cannot scrub them before the next session gets them. Returns false if
+ * the caller has to free it.
+ */
+static bool msm_vidc_mem_cache_put(struct msm_vidc_core *core,
+	struct msm_vidc_mem *mem)
+{
+	struct msm_vidc_mem_cache *cache = &core->mem_cache;
+	struct msm_vidc_mem_cache_entry *entry, *dummy;
+	u64 cap = (u64)msm_vidc_mem_cache_mb * SZ_1M;
+
+	if (!cap || mem->size > cap || !mem->device_addr)
+		return false;
+	if (mem->secure || !mem->kvaddr)
+		return false;
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		return false;
+
+	memcpy(&entry->mem, mem, sizeof(*mem));
+	INIT_LIST_HEAD(&entry->mem.list);
+
+	mutex_lock(&cache->lock);
+	list_add_tail(&entry->list, &cache->list);
+	cache->count++;
+	cache->size += mem->size;
+
+	/* release the oldest allocations until back under the cap */
+	list_for_each_entry_safe(entry, dummy, &cache->list, list) {
+		if (cache->size <= cap)
+			break;
+		msm_vidc_mem_cache_evict(core, entry);
+	}
+	mutex_unlock(&cache->lock);
+
+	return true;
+}
+
+/*
+ * Hands a cached allocation of the same region and page aligned size to
+ * mem, most recently freed first, zeroed as a fresh dma_alloc_attrs()
+ * one would be. Returns false if mem has to be allocated.
+ */
+static bool msm_vidc_mem_cache_get(struct msm_vidc_core *core,
+	struct msm_vidc_mem *mem)
+{
+	struct msm_vidc_mem_cache *cache = &core->mem_cache;
+	struct msm_vidc_mem_cache_entry *entry;
+	enum msm_vidc_buffer_type type = mem->type;
+	bool found = false;
+
+	if (!msm_vidc_mem_cache_mb || mem->secure)
+		return false;
+
+	mutex_lock(&cache->lock);
+	list_for_each_entry_reverse(entry, &cache->list, list) {
+		if (entry->mem.region != mem->region ||
+			ALIGN(entry->mem.size, SZ_4K) != ALIGN(mem->size, SZ_4K))
+			continue;
+
+		list_del(&entry->list);
+		cache->count--;
+		cache->size -= entry->mem.size;
+		found = true;
+		break;
+	}
+	if (found)
+		cache->hits++;
+	else
+		cache->misses++;
+	mutex_unlock(&cache->lock);
+
+	if (!found)
+		return false;
+
+	memcpy(mem, &entry->mem, sizeof(*mem));
+	INIT_LIST_HEAD(&mem->list);
+	mem->type = type;
+	kfree(entry);
+
+	/* firmware must not see the previous session's persist/comv data */
+	memset(mem->kvaddr, 0, ALIGN(mem->size, SZ_4K));
+
+	return true;
+}
+
+/* releases the oldest cached allocations, at least @bytes of them */
+static u64 __mem_cache_shrink(struct msm_vidc_core *core, u64 bytes)
+{
+	struct msm_vidc_mem_cache *cache = &core->mem_cache;
+	struct msm_vidc_mem_cache_entry *entry, *dummy;
+	u64 freed = 0;
+
+	list_for_each_entry_safe(entry, dummy, &cache->list, list) {
+		if (freed >= bytes)
+			break;
+		freed += entry->mem.size;
+		msm_vidc_mem_cache_evict(core, entry);
+	}
+
+	return freed;
+}
+
+void msm_vidc_mem_cache_shrink(struct msm_vidc_core *core)
+{
+	mutex_lock(&core->mem_cache.lock);
+	__mem_cache_shrink(core, U64_MAX);
+	mutex_unlock(&core->mem_cache.lock);
+}
+
+static struct msm_vidc_core *msm_vidc_shrinker_to_core(struct shrinker *shrink)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0))
+	return shrink->private_data;
+#else
+	return container_of(shrink, struct msm_vidc_core, mem_cache.shrinker);
+#endif
+}
+
+static unsigned long msm_vidc_mem_cache_count(struct shrinker *shrink,
+	struct shrink_control *sc)
+{
+	struct msm_vidc_core *core = msm_vidc_shrinker_to_core(shrink);
+	unsigned long pages = READ_ONCE(core->mem_cache.size) >> PAGE_SHIFT;
+
+	return pages ? pages : SHRINK_EMPTY;
+}
+
+static unsigned long msm_vidc_mem_cache_scan(struct shrinker *shrink,
+	struct shrink_control *sc)
+{
+	struct msm_vidc_core *core = msm_vidc_shrinker_to_core(shrink);
+	u64 freed;
+
+	/* do not stall reclaim behind a session allocating from the cache */
+	if (!mutex_trylock(&core->mem_cache.lock))
+		return SHRINK_STOP;
+	freed = __mem_cache_shrink(core, (u64)sc->nr_to_scan << PAGE_SHIFT);
+	mutex_unlock(&core->mem_cache.lock);
+
+	return freed >> PAGE_SHIFT;
+}
+
+int msm_vidc_mem_cache_init(struct msm_vidc_core *core)
+{
+	struct msm_vidc_mem_cache *cache = &core->mem_cache;
+	struct shrinker *shrink;
+
+	mutex_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->list);
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0))
+	shrink = shrinker_alloc(0, "msm_vidc_mem_cache");
+	if (!shrink) {
+		d_vpr_e("%s: shrinker alloc failed\n", __func__);
+		mutex_destroy(&cache->lock);
+		return -ENOMEM;
+	}
+	shrink->private_data = core;
+	cache->shrinker = shrink;
+#else
+	shrink = &cache->shrinker;
+#endif
+	shrink->count_objects = msm_vidc_mem_cache_count;
+	shrink->scan_objects = msm_vidc_mem_cache_scan;
+	shrink->seeks = DEFAULT_SEEKS;
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0))
+	shrinker_register(shrink);
+#elif (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0))
+	if (register_shrinker(shrink, "msm_vidc_mem_cache")) {
+		d_vpr_e("%s: shrinker register failed\n", __func__);
+		mutex_destroy(&cache->lock);
+		return -ENOMEM;
+	}
+#else
+	if (register_shrinker(shrink)) {
+		d_vpr_e("%s: shrinker register failed\n", __func__);
+		mutex_destroy(&cache->lock);
+		return -ENOMEM;
+	}
+#endif
+
+	return 0;
+}
+
+void msm_vidc_mem_cache_deinit(struct msm_vidc_core *core)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0))
+	shrinker_free(core->mem_cache.shrinker);
+	core->mem_cache.shrinker = NULL;
+#else
+	unregister_shrinker(&core->mem_cache.shrinker);
+#endif
+	msm_vidc_mem_cache_shrink(core);
+	mutex_destroy(&core->mem_cache.lock);
+}
+
+static struct msm_vidc_mem_chunk *msm_vidc_mem_chunk_new(struct msm_vidc_inst *inst,
+	struct msm_vidc_mem *mem, u32 size)
+{
+	struct msm_vidc_core *core = inst->core;
+	struct msm_vidc_mem_chunk *chunk;
+
+	chunk = kzalloc(sizeof(*chunk), GFP_KERNEL);
+	if (!chunk)
+		return NULL;
+
+	/* IOVAs are never 0, so they can be handed out by the gen_pool as is */
+	chunk->pool = gen_pool_create(ilog2(SZ_4K), -1);
+	if (!chunk->pool)
+		goto err_free_chunk;
+
+	INIT_LIST_HEAD(&chunk->mem.list);
+	chunk->mem.type = mem->type;
+	chunk->mem.region = mem->region;
+	chunk->mem.secure = mem->secure;
+	chunk->mem.size = size;
+	if (!msm_vidc_mem_cache_get(core, &chunk->mem) &&
+		call_mem_op(core, memory_alloc_map, core, &chunk->mem))
+		goto err_destroy_pool;
+
+	if (gen_pool_add(chunk->pool, chunk->mem.device_addr, size, -1)) {
+		call_mem_op(core, memory_unmap_free, core, &chunk->mem);
+		goto err_destroy_pool;
+	}
+
+	/* newest first, so buffers go to a freshly reserved arena first */
+	list_add(&chunk->list, &inst->mem_chunks.list);
+	inst->mem_chunks.count++;
+	msm_vidc_mem_account(inst, &inst->mem_chunks.size, size);
+	i_vpr_h(inst, "%s: size %u, region %d, device_addr %#llx\n",
+		__func__, size, chunk->mem.region, chunk->mem.device_addr);
+
+	return chunk;
+
+err_destroy_pool:
+	gen_pool_destroy(chunk->pool);
+err_free_chunk:
+	kfree(chunk);
+	return NULL;
+}
+
+static void msm_vidc_mem_chunk_free(struct msm_vidc_inst *inst,
+	struct msm_vidc_mem_chunk *chunk)
+{
+	struct msm_vidc_core *core = inst->core;
+
+	list_del(&chunk->list);
+	inst->mem_chunks.count--;
+	msm_vidc_mem_account(inst, &inst->mem_chunks.size,
+		-(s64)chunk->mem.size);
+	gen_pool_destroy(chunk->pool);
+	if (!msm_vidc_mem_cache_put(core, &chunk->mem))
+		call_mem_op(core, memory_unmap_free, core, &chunk->mem);
+	kfree(chunk);
+}
+
+/*
+ * Places mem in a chunk of the session with room left, allocating a new
+ * chunk if none has. Returns false if mem has to be allocated on its own.
+ */
+static bool msm_vidc_mem_chunk_carve(struct msm_vidc_inst *inst,
+	struct msm_vidc_mem *mem)
+{
+	struct msm_vidc_mem_chunk *chunk;
+	u32 chunk_size = ALIGN(msm_vidc_internal_chunk_kb * SZ_1K, SZ_4K);
+	u32 size = ALIGN(mem->size, SZ_4K);
+	unsigned long addr;
+
+	list_for_each_entry(chunk, &inst->mem_chunks.list, list) {
+		if (chunk->mem.region != mem->region)
+			continue;
+		addr = gen_pool_alloc(chunk->pool, size);
+		if (addr)
+			goto carve;
+	}
+
+	if (!chunk_size || size > chunk_size)
+		return false;
+
+	chunk = msm_vidc_mem_chunk_new(inst, mem, chunk_size);
+	if (!chunk)
+		return false;
+	addr = gen_pool_alloc(chunk->pool, size);
+
+carve:
+	mem->chunk = chunk;
+	mem->attrs = chunk->mem.attrs;
+	mem->device_addr = addr;
+	mem->kvaddr = chunk->mem.kvaddr ? (u8 *)chunk->mem.kvaddr +
+		(addr - chunk->mem.device_addr) : NULL;
+	/* the range may have held another buffer, hand it out zeroed */
+	if (mem->kvaddr)
+		memset(mem->kvaddr, 0, size);
+	chunk->refcount++;
+	inst->mem_chunks.used += size;
+
+	return true;
+}
+
+/* gives the space of mem back to its chunk, the chunk goes with its last buffer */
+static void msm_vidc_mem_chunk_put(struct msm_vidc_inst *inst,
+	struct msm_vidc_mem *mem)
+{
+	struct msm_vidc_mem_chunk *chunk = mem->chunk;
+	u32 size = ALIGN(mem->size, SZ_4K);
+
+	gen_pool_free(chunk->pool, mem->device_addr, size);
+	mem->chunk = NULL;
+	mem->kvaddr = NULL;
+	mem->device_addr = 0;
+	inst->mem_chunks.used -= size;
+	if (--chunk->refcount)
+		return;
+
+	msm_vidc_mem_chunk_free(inst, chunk);
+}
+
+/*
+ * Reserves one chunk per region for the internal buffers of the given
+ * types about to be created, so that they are carved out of a single
+ * IOVA range instead of being mapped one by one. Without memory for an
+ * arena the buffers are allocated one by one, as without arenas.
+ */
+int msm_vidc_reserve_internal_arena(struct msm_vidc_inst *inst,
+	const u32 *types, u32 count)
+{
+	struct msm_vidc_core *core = inst->core;
+	struct msm_vidc_buffers *buffers;
+	struct msm_vidc_mem mem;
+	u64 size[MSM_VIDC_REGION_MAX] = {0};
+	u32 i, region;
+
+	if (!msm_vidc_internal_arena)
+		return 0;
+
+	for (i = 0; i < count; i++) {
+		buffers = msm_vidc_get_buffers(inst, types[i], __func__);
+		if (!buffers)
+			return -EINVAL;
+		if (buffers->reuse || !buffers->size)
+			continue;
+
+		region = call_mem_op(core, buffer_region, inst, types[i]);
+		if (region >= MSM_VIDC_REGION_MAX)
+			continue;
+		size[region] += (u64)ALIGN(buffers->size, SZ_4K) * buffers->min_count;
+	}
+
+	for (region = 0; region < MSM_VIDC_REGION_MAX; region++) {
+		if (!size[region])
+			continue;
+
+		memset(&mem, 0, sizeof(mem));
+		mem.type = types[0];
+		mem.region = region;
+		mem.secure = is_secure_region(region);
+		if (!msm_vidc_mem_chunk_new(inst, &mem, ALIGN(size[region], SZ_1M)))
+			i_vpr_h(inst, "%s: no arena for region %u, size %llu\n",
+				__func__, region, size[region]);
+	}
+
+	return 0;
+}
+
+/* drops arenas no buffer was carved out of, at the end of a create pass */
+void msm_vidc_release_internal_arena(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_mem_chunk *chunk, *dummy;
+
+	list_for_each_entry_safe(chunk, dummy, &inst->mem_chunks.list, list) {
+		if (!chunk->refcount)
+			msm_vidc_mem_chunk_free(inst, chunk);
+	}
+}
+
+/* unmaps mem, or gives it back to its chunk, and drops it from its mem list */
+static void msm_vidc_free_internal_mem(struct msm_vidc_inst *inst,
+	struct msm_vidc_mem *mem)
+{
+	struct msm_vidc_core *core = inst->core;
+
+	if (mem->chunk) {
+		inst->mem_usage.internal[mem->type] -= mem->size;
+		msm_vidc_mem_chunk_put(inst, mem);
+	} else {
+		msm_vidc_mem_account(inst,
+			&inst->mem_usage.internal[mem->type],
+			-(s64)mem->size);
+		if (!msm_vidc_mem_cache_put(core, mem))
+			call_mem_op(core, memory_unmap_free, core, mem);
+	}
+	list_del(&mem->list);
+	msm_vidc_pool_free(inst, mem);
+}
+
 int msm_vidc_destroy_internal_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buffer)
 {
@@ -2740,9 +3634,6 @@ int msm_vidc_destroy_internal_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_mem_list *mem_list;
 	struct msm_vidc_mem *mem, *mem_dummy;
 	struct msm_vidc_buffer *buf, *dummy;
-	struct msm_vidc_core *core;
-
-	core = inst->core;
 
 	if (!is_internal_buffer(buffer->type)) {
 		i_vpr_e(inst, "%s: type: %s is not internal\n",
@@ -2761,10 +3652,9 @@ int msm_vidc_destroy_internal_buffer(struct msm_vidc_inst *inst,
 		return -EINVAL;
 
 	list_for_each_entry_safe(mem, mem_dummy, &mem_list->list, list) {
-		if (mem->dmabuf == buffer->dmabuf) {
-			call_mem_op(core, memory_unmap_free, core, mem);
-			list_del(&mem->list);
-			msm_vidc_pool_free(inst, mem);
+		if (mem->dmabuf == buffer->dmabuf &&
+			mem->device_addr == buffer->device_addr) {
+			msm_vidc_free_internal_mem(inst, mem);
 			break;
 		}
 	}
@@ -2872,10 +3762,19 @@ int msm_vidc_create_internal_buffer(struct msm_vidc_inst *inst,
 	mem->region = call_mem_op(core, buffer_region, inst, buffer_type);
 	mem->size = buffer->buffer_size;
 	mem->secure = is_secure_region(mem->region);
-	rc = call_mem_op(core, memory_alloc_map, core, mem);
-	if (rc)
-		return -ENOMEM;
+	if (!msm_vidc_mem_chunk_carve(inst, mem) &&
+		!msm_vidc_mem_cache_get(core, mem)) {
+		rc = call_mem_op(core, memory_alloc_map, core, mem);
+		if (rc)
+			return -ENOMEM;
+	}
 	list_add_tail(&mem->list, &mem_list->list);
+	/* carved buffers are charged through their chunk */
+	if (mem->chunk)
+		inst->mem_usage.internal[buffer_type] += mem->size;
+	else
+		msm_vidc_mem_account(inst, &inst->mem_usage.internal[buffer_type],
+			mem->size);
 
 	buffer->dmabuf = mem->dmabuf;
 	buffer->device_addr = mem->device_addr;
@@ -2948,7 +3847,7 @@ int msm_vidc_queue_internal_buffers(struct msm_vidc_inst *inst,
 		if (rc)
 			return rc;
 		/* mark queued */
-		buffer->attr |= MSM_VIDC_ATTR_QUEUED;
+		msm_vidc_update_buffer_attr(inst, buffer, MSM_VIDC_ATTR_QUEUED, 0);
 
 		i_vpr_h(inst, "%s: queue: type: %8s, size: %9u, device_addr %#llx\n", __func__,
 			buf_name(buffer->type), buffer->buffer_size, buffer->device_addr);
@@ -3019,7 +3918,7 @@ int msm_vidc_release_internal_buffers(struct msm_vidc_inst *inst,
 		if (rc)
 			return rc;
 		/* mark pending release */
-		buffer->attr |= MSM_VIDC_ATTR_PENDING_RELEASE;
+		msm_vidc_update_buffer_attr(inst, buffer, MSM_VIDC_ATTR_PENDING_RELEASE, 0);
 
 		i_vpr_h(inst, "%s: release: type: %8s, size: %9u, device_addr %#llx\n", __func__,
 			buf_name(buffer->type), buffer->buffer_size, buffer->device_addr);
@@ -3334,6 +4233,8 @@ int msm_vidc_remove_session(struct msm_vidc_inst *inst)
 
 	core = inst->core;
 
+	venus_hfi_session_backlog_drop(inst);
+
 	core_lock(core, __func__);
 	list_for_each_entry_safe(i, temp, &core->instances, list) {
 		if (i->session_id == inst->session_id) {
@@ -3388,6 +4289,13 @@ int msm_vidc_session_open(struct msm_vidc_inst *inst)
 		i_vpr_e(inst, "%s: allocation failed\n", __func__);
 		return -ENOMEM;
 	}
+	inst->prop_packet = vzalloc(inst->packet_size);
+	if (!inst->prop_packet) {
+		i_vpr_e(inst, "%s: allocation failed\n", __func__);
+		rc = -ENOMEM;
+		goto error;
+	}
+	msm_vidc_mem_account(inst, &inst->mem_usage.packet, 2 * inst->packet_size);
 
 	rc = venus_hfi_session_open(inst);
 	if (rc)
@@ -3396,6 +4304,11 @@ int msm_vidc_session_open(struct msm_vidc_inst *inst)
 	return 0;
 error:
 	i_vpr_e(inst, "%s(): session open failed\n", __func__);
+	if (inst->prop_packet)
+		msm_vidc_mem_account(inst, &inst->mem_usage.packet,
+			-2 * (s64)inst->packet_size);
+	vfree(inst->prop_packet);
+	inst->prop_packet = NULL;
 	vfree(inst->packet);
 	inst->packet = NULL;
 	return rc;
@@ -3447,15 +4360,11 @@ int msm_vidc_session_streamoff(struct msm_vidc_inst *inst,
 {
 	int rc = 0;
 	int count = 0;
-	struct msm_vidc_core *core;
-	enum signal_session_response signal_type;
 	enum msm_vidc_buffer_type buffer_type;
 
 	if (port == INPUT_PORT) {
-		signal_type = SIGNAL_CMD_STOP_INPUT;
 		buffer_type = MSM_VIDC_BUF_INPUT;
 	} else if (port == OUTPUT_PORT) {
-		signal_type = SIGNAL_CMD_STOP_OUTPUT;
 		buffer_type = MSM_VIDC_BUF_OUTPUT;
 	} else {
 		i_vpr_e(inst, "%s: invalid port: %d\n", __func__, port);
@@ -3466,26 +4375,13 @@ int msm_vidc_session_streamoff(struct msm_vidc_inst *inst,
 	if (rc)
 		goto error;
 
-	core = inst->core;
-	i_vpr_h(inst, "%s: wait on port: %d for time: %d ms\n",
-		__func__, port, core->capabilities[HW_RESPONSE_TIMEOUT].value);
-	inst_unlock(inst, __func__);
-	rc = wait_for_completion_timeout(
-			&inst->completions[signal_type],
-			msecs_to_jiffies(
-			core->capabilities[HW_RESPONSE_TIMEOUT].value));
-	if (!rc) {
+	/* only the stop of this port, the other port may still be busy */
+	rc = msm_vidc_wait_for_session_cmd(inst, inst->last_cmd_id, __func__);
+	if (rc) {
 		i_vpr_e(inst, "%s: session stop timed out for port: %d\n",
 				__func__, port);
-		rc = -ETIMEDOUT;
-		msm_vidc_inst_timeout(inst);
-	} else {
-		rc = 0;
-	}
-	inst_lock(inst, __func__);
-
-	if (rc)
 		goto error;
+	}
 
 	if (port == INPUT_PORT) {
 		/* flush input timer list */
@@ -3510,12 +4406,14 @@ int msm_vidc_session_streamoff(struct msm_vidc_inst *inst,
 		goto error;
 
 	/* flush deferred buffers */
+	inst->backlog_held &= ~BIT(buffer_type);
 	msm_vidc_flush_buffers(inst, buffer_type);
 	msm_vidc_flush_read_only_buffers(inst, buffer_type);
 	return 0;
 
 error:
 	msm_vidc_kill_session(inst);
+	inst->backlog_held &= ~BIT(buffer_type);
 	msm_vidc_flush_buffers(inst, buffer_type);
 	msm_vidc_flush_read_only_buffers(inst, buffer_type);
 	return rc;
@@ -3529,6 +4427,12 @@ int msm_vidc_session_close(struct msm_vidc_inst *inst)
 
 	core = inst->core;
 
+	/*
+	 * firmware may drop pending commands of a session being killed,
+	 * only wait for the close response itself.
+	 */
+	memset(inst->pending_cmds, 0, sizeof(inst->pending_cmds));
+
 	wait_for_response = true;
 	rc = venus_hfi_session_close(inst);
 	if (rc) {
@@ -3538,26 +4442,23 @@ int msm_vidc_session_close(struct msm_vidc_inst *inst)
 
 	/* we are not supposed to send any more commands after close */
 	i_vpr_h(inst, "%s: free session packet data\n", __func__);
+	if (inst->prop_packet)
+		msm_vidc_mem_account(inst, &inst->mem_usage.packet,
+			-2 * (s64)inst->packet_size);
+	vfree(inst->prop_packet);
+	inst->prop_packet = NULL;
+	inst->prop_batch = 0;
 	vfree(inst->packet);
 	inst->packet = NULL;
 
 	if (wait_for_response) {
-		i_vpr_h(inst, "%s: wait on close for time: %d ms\n",
-		__func__, core->capabilities[HW_RESPONSE_TIMEOUT].value);
-		inst_unlock(inst, __func__);
-		rc = wait_for_completion_timeout(
-				&inst->completions[SIGNAL_CMD_CLOSE],
-				msecs_to_jiffies(
-				core->capabilities[HW_RESPONSE_TIMEOUT].value));
-		if (!rc) {
+		rc = msm_vidc_wait_for_session_cmd(inst, inst->last_cmd_id,
+						   __func__);
+		if (rc) {
 			i_vpr_e(inst, "%s: session close timed out\n", __func__);
-			rc = -ETIMEDOUT;
-			msm_vidc_inst_timeout(inst);
 		} else {
-			rc = 0;
 			i_vpr_h(inst, "%s: close successful\n", __func__);
 		}
-		inst_lock(inst, __func__);
 	}
 
 	return rc;
@@ -4435,8 +5336,7 @@ int msm_vidc_flush_read_only_buffers(struct msm_vidc_inst *inst,
 			continue;
 		print_vidc_buffer(VIDC_ERR, "high", "flush ro buf", inst, ro_buf);
 		if (ro_buf->attach && ro_buf->sg_table)
-			call_mem_op(core, dma_buf_unmap_attachment, core,
-				ro_buf->attach, ro_buf->sg_table);
+			msm_vidc_unmap_dmabuf(inst, ro_buf->attach, ro_buf->sg_table);
 		if (ro_buf->attach && ro_buf->dmabuf)
 			call_mem_op(core, dma_buf_detach, core,
 				ro_buf->dmabuf, ro_buf->attach);
@@ -4461,13 +5361,14 @@ void msm_vidc_destroy_buffers(struct msm_vidc_inst *inst)
 {
 	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf, *dummy;
-	struct msm_vidc_timestamp *ts, *dummy_ts;
 	struct msm_memory_dmabuf *dbuf, *dummy_dbuf;
 	struct msm_vidc_input_timer *timer, *dummy_timer;
 	struct msm_vidc_buffer_stats *stats, *dummy_stats;
 	struct msm_vidc_inst_cap_entry *entry, *dummy_entry;
 	struct msm_vidc_input_cr_data *cr, *dummy_cr;
 	struct msm_vidc_fence *fence, *dummy_fence;
+	struct msm_vidc_mem_list *mem_list;
+	struct msm_vidc_mem *mem, *dummy_mem;
 	struct msm_vidc_core *core;
 
 	static const enum msm_vidc_buffer_type ext_buf_types[] = {
@@ -4503,6 +5404,27 @@ void msm_vidc_destroy_buffers(struct msm_vidc_inst *inst)
 		}
 	}
 
+	/* memory of internal buffers which failed to destroy */
+	for (i = 0; i < ARRAY_SIZE(internal_buf_types); i++) {
+		mem_list = msm_vidc_get_mem_info(inst, internal_buf_types[i], __func__);
+		if (!mem_list)
+			continue;
+		list_for_each_entry_safe(mem, dummy_mem, &mem_list->list, list) {
+			i_vpr_e(inst, "%s: leftover %s mem, device_addr %#llx\n",
+				__func__, buf_name(mem->type), mem->device_addr);
+			msm_vidc_free_internal_mem(inst, mem);
+		}
+	}
+
+	/* only arenas reserved for buffers that were never created remain */
+	msm_vidc_release_internal_arena(inst);
+	if (inst->mem_chunks.count)
+		i_vpr_e(inst, "%s: %u chunks still referenced\n",
+			__func__, inst->mem_chunks.count);
+
+	/* vb2 queues are released by now, drop mappings kept for reuse */
+	msm_vidc_map_cache_flush(inst, MSM_VIDC_BUF_NONE);
+
 	/*
 	 * read_only list does not take dma ref_count using dma_buf_get().
 	 * dma_buf ptr will be obselete when its ref_count reaches zero.
@@ -4511,8 +5433,7 @@ void msm_vidc_destroy_buffers(struct msm_vidc_inst *inst)
 	list_for_each_entry_safe(buf, dummy, &inst->buffers.read_only.list, list) {
 		print_vidc_buffer(VIDC_ERR, "err ", "destroying ro buf", inst, buf);
 		if (buf->attach && buf->sg_table)
-			call_mem_op(core, dma_buf_unmap_attachment, core,
-				buf->attach, buf->sg_table);
+			msm_vidc_unmap_dmabuf(inst, buf->attach, buf->sg_table);
 		if (buf->attach && buf->dmabuf)
 			call_mem_op(core, dma_buf_detach, core, buf->dmabuf, buf->attach);
 		if (buf->kvaddr && buf->device_addr && refcount_read(&buf->refcount) > 0)
@@ -4531,8 +5452,7 @@ void msm_vidc_destroy_buffers(struct msm_vidc_inst *inst)
 
 		list_for_each_entry_safe(buf, dummy, &buffers->list, list) {
 			if (buf->attach && buf->sg_table)
-				call_mem_op(core, dma_buf_unmap_attachment, core,
-					buf->attach, buf->sg_table);
+				msm_vidc_unmap_dmabuf(inst, buf->attach, buf->sg_table);
 			if (buf->attach && buf->dmabuf)
 				call_mem_op(core, dma_buf_detach, core, buf->dmabuf, buf->attach);
 			if (buf->kvaddr && buf->device_addr && refcount_read(&buf->refcount) > 0)
@@ -4546,21 +5466,21 @@ void msm_vidc_destroy_buffers(struct msm_vidc_inst *inst)
 			list_del_init(&buf->list);
 			msm_vidc_pool_free(inst, buf);
 		}
-	}
-
-	list_for_each_entry_safe(ts, dummy_ts, &inst->timestamps.list, sort.list) {
-		i_vpr_e(inst, "%s: removing ts: val %lld, rank %lld\n",
-			__func__, ts->sort.val, ts->rank);
-		list_del(&ts->sort.list);
-		msm_vidc_pool_free(inst, ts);
-	}
-
-	list_for_each_entry_safe(ts, dummy_ts, &inst->ts_reorder.list, sort.list) {
-		i_vpr_e(inst, "%s: removing reorder ts: val %lld\n",
-			__func__, ts->sort.val);
-		list_del(&ts->sort.list);
-		msm_vidc_pool_free(inst, ts);
-	}
+		kfree(buffers->table);
+		buffers->table = NULL;
+		buffers->table_size = 0;
+		memset(buffers->attr_count, 0, sizeof(buffers->attr_count));
+	}
+
+	if (inst->ts_reorder.count)
+		i_vpr_e(inst, "%s: removing %u reorder ts\n",
+			__func__, inst->ts_reorder.count);
+	kfree(inst->ts_reorder.entries);
+	kfree(inst->ts_reorder.heap);
+	inst->ts_reorder.entries = NULL;
+	inst->ts_reorder.heap = NULL;
+	inst->ts_reorder.count = 0;
+	inst->ts_reorder.size = 0;
 
 	list_for_each_entry_safe(timer, dummy_timer, &inst->input_timer_list, list) {
 		i_vpr_e(inst, "%s: removing input_timer %lld\n",
@@ -5150,6 +6070,68 @@ int msm_vidc_check_core_mbpf(struct msm_vidc_inst *inst)
 	return 0;
 }
 
+/*
+ * Memory the session still has to allocate for the internal buffer sizes
+ * and counts known so far.
+ */
+static u64 msm_vidc_pending_internal_mem(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_buffers *buffers;
+	u64 needed, pending = 0;
+	u32 type;
+
+	for (type = MSM_VIDC_BUF_BIN; type <= MSM_VIDC_BUF_PARTIAL_DATA; type++) {
+		buffers = msm_vidc_get_buffers(inst, type, __func__);
+		if (!buffers)
+			continue;
+
+		needed = (u64)ALIGN(buffers->size, SZ_4K) * buffers->min_count;
+		if (needed > inst->mem_usage.internal[type])
+			pending += needed - inst->mem_usage.internal[type];
+	}
+
+	return pending;
+}
+
+/* session owned memory plus internal buffers parked in the mem cache */
+static u64 msm_vidc_core_mem_used(struct msm_vidc_core *core)
+{
+	u64 used;
+
+	mutex_lock(&core->mem_cache.lock);
+	used = core->mem_cache.size;
+	mutex_unlock(&core->mem_cache.lock);
+
+	return used + atomic64_read(&core->mem_usage);
+}
+
+int msm_vidc_check_core_mem(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_core *core;
+	u64 budget, used, pending;
+
+	core = inst->core;
+
+	budget = (u64)msm_vidc_mem_budget_mb * SZ_1M;
+	if (!budget)
+		return 0;
+
+	pending = msm_vidc_pending_internal_mem(inst);
+	used = msm_vidc_core_mem_used(core);
+	if (used + pending <= budget)
+		return 0;
+
+	/* give the cached internal buffers back before turning the session down */
+	msm_vidc_mem_cache_shrink(core);
+	used = msm_vidc_core_mem_used(core);
+	if (used + pending <= budget)
+		return 0;
+
+	i_vpr_e(inst, "%s: memory overloaded. used %llu, needed %llu, budget %llu\n",
+		__func__, used, pending, budget);
+	return -ENOMEM;
+}
+
 static int msm_vidc_check_inst_mbpf(struct msm_vidc_inst *inst)
 {
 	u32 mbpf = 0, max_mbpf = 0;
@@ -5447,6 +6429,10 @@ int msm_vidc_check_session_supported(struct msm_vidc_inst *inst)
 	if (rc)
 		goto exit;
 
+	rc = msm_vidc_check_core_mem(inst);
+	if (rc)
+		goto exit;
+
 	rc = msm_vidc_check_inst_mbpf(inst);
 	if (rc)
 		goto exit;
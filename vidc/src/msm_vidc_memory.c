@@ -7,6 +7,7 @@
 #include <linux/dma-buf.h>
 #include <linux/dma-heap.h>
 #include <linux/dma-mapping.h>
+#include <linux/slab.h>
 
 #include "msm_vidc_memory.h"
 #include "msm_vidc_internal.h"
@@ -27,19 +28,59 @@ struct msm_vidc_type_size_name {
 	enum msm_memory_pool_type type;
 	u32                       size;
 	char                     *name;
+	char                     *cache_name;
 };
 
 static const struct msm_vidc_type_size_name buftype_size_name_arr[] = {
-	{MSM_MEM_POOL_BUFFER,     sizeof(struct msm_vidc_buffer),     "MSM_MEM_POOL_BUFFER"     },
-	{MSM_MEM_POOL_ALLOC_MAP,  sizeof(struct msm_vidc_mem),        "MSM_MEM_POOL_ALLOC_MAP"  },
-	{MSM_MEM_POOL_TIMESTAMP,  sizeof(struct msm_vidc_timestamp),  "MSM_MEM_POOL_TIMESTAMP"  },
-	{MSM_MEM_POOL_DMABUF,     sizeof(struct msm_memory_dmabuf),   "MSM_MEM_POOL_DMABUF"     },
+	{MSM_MEM_POOL_BUFFER,     sizeof(struct msm_vidc_buffer),     "MSM_MEM_POOL_BUFFER",
+		"msm_vidc_buffer"     },
+	{MSM_MEM_POOL_ALLOC_MAP,  sizeof(struct msm_vidc_mem),        "MSM_MEM_POOL_ALLOC_MAP",
+		"msm_vidc_alloc_map"  },
+	{MSM_MEM_POOL_DMABUF,     sizeof(struct msm_memory_dmabuf),   "MSM_MEM_POOL_DMABUF",
+		"msm_vidc_dmabuf"     },
 	{MSM_MEM_POOL_PACKET,     sizeof(struct hfi_pending_packet) + MSM_MEM_POOL_PACKET_SIZE,
-		"MSM_MEM_POOL_PACKET"},
-	{MSM_MEM_POOL_BUF_TIMER,  sizeof(struct msm_vidc_input_timer), "MSM_MEM_POOL_BUF_TIMER" },
-	{MSM_MEM_POOL_BUF_STATS,  sizeof(struct msm_vidc_buffer_stats), "MSM_MEM_POOL_BUF_STATS"},
+		"MSM_MEM_POOL_PACKET", "msm_vidc_packet"     },
+	{MSM_MEM_POOL_BUF_TIMER,  sizeof(struct msm_vidc_input_timer), "MSM_MEM_POOL_BUF_TIMER",
+		"msm_vidc_buf_timer"  },
+	{MSM_MEM_POOL_BUF_STATS,  sizeof(struct msm_vidc_buffer_stats), "MSM_MEM_POOL_BUF_STATS",
+		"msm_vidc_buf_stats"  },
+	{MSM_MEM_POOL_MAP,        sizeof(struct msm_memory_map),      "MSM_MEM_POOL_MAP",
+		"msm_vidc_map"        },
 };
 
+static struct msm_memory_alloc_header *msm_vidc_pool_new(
+	struct msm_vidc_inst *inst, struct msm_memory_pool *pool,
+	enum msm_memory_pool_type type)
+{
+	struct msm_memory_alloc_header *hdr;
+
+	hdr = kmem_cache_zalloc(pool->cache, GFP_KERNEL);
+	if (!hdr) {
+		i_vpr_e(inst, "%s: allocation failed. type %s\n",
+			__func__, pool->name);
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&hdr->list);
+	hdr->type = type;
+	hdr->buf = (void *)(hdr + 1);
+	pool->cache_allocs++;
+	msm_vidc_mem_account(inst, &inst->mem_usage.pool,
+		sizeof(*hdr) + pool->size);
+
+	return hdr;
+}
+
+static void msm_vidc_pool_release(struct msm_vidc_inst *inst,
+	struct msm_memory_pool *pool, struct msm_memory_alloc_header *hdr)
+{
+	list_del(&hdr->list);
+	kmem_cache_free(pool->cache, hdr);
+	pool->cache_frees++;
+	msm_vidc_mem_account(inst, &inst->mem_usage.pool,
+		-(s64)(sizeof(*hdr) + pool->size));
+}
+
 void *msm_vidc_pool_alloc(struct msm_vidc_inst *inst, enum msm_memory_pool_type type)
 {
 	struct msm_memory_alloc_header *hdr = NULL;
@@ -55,30 +96,23 @@ void *msm_vidc_pool_alloc(struct msm_vidc_inst *inst, enum msm_memory_pool_type
 		/* get 1st node from free pool */
 		hdr = list_first_entry(&pool->free_pool,
 			struct msm_memory_alloc_header, list);
-
-		/* move node from free pool to busy pool */
-		list_move_tail(&hdr->list, &pool->busy_pool);
+		pool->free_count--;
+		pool->reuse_count++;
 
 		/* reset existing data */
 		memset((char *)hdr->buf, 0, pool->size);
-
-		/* set busy flag to true. This is to catch double free request */
-		hdr->busy = true;
-
-		return hdr->buf;
-	}
-
-	hdr = vzalloc(pool->size + sizeof(struct msm_memory_alloc_header));
-	if (!hdr) {
-		i_vpr_e(inst, "%s: allocation failed\n", __func__);
-		return NULL;
+	} else {
+		hdr = msm_vidc_pool_new(inst, pool, type);
+		if (!hdr)
+			return NULL;
 	}
 
-	INIT_LIST_HEAD(&hdr->list);
-	hdr->type = type;
+	/* set busy flag to true. This is to catch double free request */
 	hdr->busy = true;
-	hdr->buf = (void *)(hdr + 1);
-	list_add_tail(&hdr->list, &pool->busy_pool);
+	list_move_tail(&hdr->list, &pool->busy_pool);
+	pool->busy_count++;
+	if (pool->busy_count > pool->peak_busy)
+		pool->peak_busy = pool->busy_count;
 
 	return hdr->buf;
 }
@@ -114,9 +148,47 @@ void msm_vidc_pool_free(struct msm_vidc_inst *inst, void *vidc_buf)
 		return;
 	}
 	hdr->busy = false;
+	pool->busy_count--;
+
+	/* free pool is bounded, give surplus nodes back to the slab */
+	if (pool->free_count >= pool->max_free) {
+		msm_vidc_pool_release(inst, pool, hdr);
+		return;
+	}
 
 	/* move node from busy pool to free pool */
 	list_move_tail(&hdr->list, &pool->free_pool);
+	pool->free_count++;
+}
+
+/*
+ * Fills the free pool so that at least count objects of the given type
+ * exist without touching the slab, and raises the free pool bound to
+ * match. Called at streamon with the negotiated buffer counts, so the
+ * per frame alloc/free calls only move nodes between the two lists.
+ */
+int msm_vidc_pool_prealloc(struct msm_vidc_inst *inst,
+	enum msm_memory_pool_type type, u32 count)
+{
+	struct msm_memory_alloc_header *hdr;
+	struct msm_memory_pool *pool;
+
+	if (type < 0 || type >= MSM_MEM_POOL_MAX) {
+		d_vpr_e("%s: Invalid params\n", __func__);
+		return -EINVAL;
+	}
+	pool = &inst->pool[type];
+
+	pool->max_free = max_t(u32, count, MSM_MEM_POOL_MIN_FREE);
+	while (pool->free_count + pool->busy_count < count) {
+		hdr = msm_vidc_pool_new(inst, pool, type);
+		if (!hdr)
+			return -ENOMEM;
+		list_add_tail(&hdr->list, &pool->free_pool);
+		pool->free_count++;
+	}
+
+	return 0;
 }
 
 static void msm_vidc_destroy_pool_buffers(struct msm_vidc_inst *inst,
@@ -139,24 +211,27 @@ static void msm_vidc_destroy_pool_buffers(struct msm_vidc_inst *inst,
 
 	/* destroy all free buffers */
 	list_for_each_entry_safe(hdr, dummy, &pool->free_pool, list) {
-		list_del(&hdr->list);
-		vfree(hdr);
+		msm_vidc_pool_release(inst, pool, hdr);
 		fcount++;
 	}
 
 	/* destroy all busy buffers */
 	list_for_each_entry_safe(hdr, dummy, &pool->busy_pool, list) {
-		list_del(&hdr->list);
-		vfree(hdr);
+		msm_vidc_pool_release(inst, pool, hdr);
 		bcount++;
 	}
+	pool->free_count = 0;
+	pool->busy_count = 0;
 
-	i_vpr_h(inst, "%s: type: %23s, count: free %2u, busy %2u\n",
-		__func__, pool->name, fcount, bcount);
+	i_vpr_h(inst,
+		"%s: type: %23s, count: free %2u, busy %2u, peak %2u, allocs %llu, reuse %llu\n",
+		__func__, pool->name, fcount, bcount, pool->peak_busy,
+		pool->cache_allocs, pool->reuse_count);
 }
 
 int msm_vidc_pools_init(struct msm_vidc_inst *inst)
 {
+	struct msm_vidc_core *core = inst->core;
 	u32 i;
 
 	if (ARRAY_SIZE(buftype_size_name_arr) != MSM_MEM_POOL_MAX) {
@@ -171,8 +246,16 @@ int msm_vidc_pools_init(struct msm_vidc_inst *inst)
 				i, buftype_size_name_arr[i].type);
 			return -EINVAL;
 		}
+		if (!core->pool_cache[i]) {
+			i_vpr_e(inst, "%s: no cache for %s\n", __func__,
+				buftype_size_name_arr[i].name);
+			return -EINVAL;
+		}
+		memset(&inst->pool[i], 0, sizeof(inst->pool[i]));
 		inst->pool[i].size = buftype_size_name_arr[i].size;
 		inst->pool[i].name = buftype_size_name_arr[i].name;
+		inst->pool[i].cache = core->pool_cache[i];
+		inst->pool[i].max_free = MSM_MEM_POOL_MIN_FREE;
 		INIT_LIST_HEAD(&inst->pool[i].free_pool);
 		INIT_LIST_HEAD(&inst->pool[i].busy_pool);
 	}
@@ -189,11 +272,72 @@ void msm_vidc_pools_deinit(struct msm_vidc_inst *inst)
 		msm_vidc_destroy_pool_buffers(inst, i);
 }
 
+/*
+ * One slab cache per pool type, shared by all sessions of the core.
+ * Objects carry their msm_memory_alloc_header in front of the payload.
+ */
+int msm_vidc_pool_caches_init(struct msm_vidc_core *core)
+{
+	u32 i;
+
+	for (i = 0; i < ARRAY_SIZE(buftype_size_name_arr); i++) {
+		core->pool_cache[i] = kmem_cache_create(
+			buftype_size_name_arr[i].cache_name,
+			sizeof(struct msm_memory_alloc_header) +
+				buftype_size_name_arr[i].size,
+			0, SLAB_HWCACHE_ALIGN, NULL);
+		if (!core->pool_cache[i]) {
+			d_vpr_e("%s: failed to create cache %s\n", __func__,
+				buftype_size_name_arr[i].cache_name);
+			msm_vidc_pool_caches_deinit(core);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+void msm_vidc_pool_caches_deinit(struct msm_vidc_core *core)
+{
+	u32 i;
+
+	for (i = 0; i < MSM_MEM_POOL_MAX; i++) {
+		kmem_cache_destroy(core->pool_cache[i]);
+		core->pool_cache[i] = NULL;
+	}
+}
+
+static struct msm_memory_dmabuf *msm_vidc_dma_buf_find(
+	struct msm_vidc_inst *inst, struct dma_buf *dmabuf)
+{
+	struct msm_memory_dmabuf *buf;
+
+	hash_for_each_possible(inst->dmabuf_hash, buf, hnode, (unsigned long)dmabuf) {
+		if (buf->dmabuf == dmabuf)
+			return buf;
+	}
+
+	return NULL;
+}
+
+static void msm_vidc_dma_buf_untrack(struct msm_vidc_inst *inst,
+	struct msm_memory_dmabuf *buf)
+{
+	/* remove dmabuf entry from tracker */
+	list_del(&buf->list);
+	hash_del(&buf->hnode);
+
+	/* release dmabuf strong ref from tracker */
+	dma_buf_put(buf->dmabuf);
+
+	/* put tracker instance back to pool */
+	msm_vidc_pool_free(inst, buf);
+}
+
 static struct dma_buf *msm_vidc_dma_buf_get(struct msm_vidc_inst *inst, int fd)
 {
 	struct msm_memory_dmabuf *buf = NULL;
 	struct dma_buf *dmabuf = NULL;
-	bool found = false;
 
 	/* get local dmabuf ref for tracking */
 	dmabuf = dma_buf_get(fd);
@@ -204,14 +348,9 @@ static struct dma_buf *msm_vidc_dma_buf_get(struct msm_vidc_inst *inst, int fd)
 	}
 
 	/* track dmabuf - inc refcount if already present */
-	list_for_each_entry(buf, &inst->dmabuf_tracker, list) {
-		if (buf->dmabuf == dmabuf) {
-			buf->refcount++;
-			found = true;
-			break;
-		}
-	}
-	if (found) {
+	buf = msm_vidc_dma_buf_find(inst, dmabuf);
+	if (buf) {
+		buf->refcount++;
 		/* put local dmabuf ref */
 		dma_buf_put(dmabuf);
 		return dmabuf;
@@ -231,6 +370,7 @@ static struct dma_buf *msm_vidc_dma_buf_get(struct msm_vidc_inst *inst, int fd)
 
 	/* add new dmabuf entry to tracker */
 	list_add_tail(&buf->list, &inst->dmabuf_tracker);
+	hash_add(inst->dmabuf_hash, &buf->hnode, (unsigned long)dmabuf);
 
 	return dmabuf;
 }
@@ -238,7 +378,6 @@ static struct dma_buf *msm_vidc_dma_buf_get(struct msm_vidc_inst *inst, int fd)
 static void msm_vidc_dma_buf_put(struct msm_vidc_inst *inst, struct dma_buf *dmabuf)
 {
 	struct msm_memory_dmabuf *buf = NULL;
-	bool found = false;
 
 	if (!dmabuf) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -246,30 +385,18 @@ static void msm_vidc_dma_buf_put(struct msm_vidc_inst *inst, struct dma_buf *dma
 	}
 
 	/* track dmabuf - dec refcount if already present */
-	list_for_each_entry(buf, &inst->dmabuf_tracker, list) {
-		if (buf->dmabuf == dmabuf) {
-			buf->refcount--;
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	buf = msm_vidc_dma_buf_find(inst, dmabuf);
+	if (!buf) {
 		i_vpr_e(inst, "%s: invalid dmabuf %p\n", __func__, dmabuf);
 		return;
 	}
+	buf->refcount--;
 
 	/* non-zero refcount - do nothing */
 	if (buf->refcount)
 		return;
 
-	/* remove dmabuf entry from tracker */
-	list_del(&buf->list);
-
-	/* release dmabuf strong ref from tracker */
-	dma_buf_put(buf->dmabuf);
-
-	/* put tracker instance back to pool */
-	msm_vidc_pool_free(inst, buf);
+	msm_vidc_dma_buf_untrack(inst, buf);
 }
 
 static void msm_vidc_dma_buf_put_completely(struct msm_vidc_inst *inst,
@@ -283,14 +410,7 @@ static void msm_vidc_dma_buf_put_completely(struct msm_vidc_inst *inst,
 	while (buf->refcount) {
 		buf->refcount--;
 		if (!buf->refcount) {
-			/* remove dmabuf entry from tracker */
-			list_del(&buf->list);
-
-			/* release dmabuf strong ref from tracker */
-			dma_buf_put(buf->dmabuf);
-
-			/* put tracker instance back to pool */
-			msm_vidc_pool_free(inst, buf);
+			msm_vidc_dma_buf_untrack(inst, buf);
 			break;
 		}
 	}
@@ -332,6 +452,20 @@ static int msm_vidc_dma_buf_detach(struct msm_vidc_core *core,
 	return rc;
 }
 
+/* client dmabufs are mapped per device, find the bank to charge */
+static void msm_vidc_iova_account(struct msm_vidc_core *core,
+	struct device *dev, s64 bytes)
+{
+	struct context_bank_info *cb;
+
+	venus_hfi_for_each_context_bank(core, cb) {
+		if (cb->dev == dev) {
+			atomic64_add(bytes, &cb->iova_size);
+			return;
+		}
+	}
+}
+
 static int msm_vidc_dma_buf_unmap_attachment(struct msm_vidc_core *core,
 	struct dma_buf_attachment *attach, struct sg_table *table)
 {
@@ -343,6 +477,7 @@ static int msm_vidc_dma_buf_unmap_attachment(struct msm_vidc_core *core,
 	}
 
 	dma_buf_unmap_attachment(attach, table, DMA_BIDIRECTIONAL);
+	msm_vidc_iova_account(core, attach->dev, -(s64)attach->dmabuf->size);
 
 	return rc;
 }
@@ -364,6 +499,7 @@ static struct sg_table *msm_vidc_dma_buf_map_attachment(
 		d_vpr_e("Failed to map table, error %d\n", rc);
 		return NULL;
 	}
+	msm_vidc_iova_account(core, attach->dev, attach->dmabuf->size);
 	if (!table->sgl) {
 		d_vpr_e("%s: sgl is NULL\n", __func__);
 		msm_vidc_dma_buf_unmap_attachment(core, attach, table);
@@ -398,6 +534,7 @@ static int msm_vidc_memory_alloc_map(struct msm_vidc_core *core, struct msm_vidc
 		d_vpr_e("%s: dma_alloc_attrs returned NULL\n", __func__);
 		return -ENOMEM;
 	}
+	atomic64_add(size, &cb->iova_size);
 
 	d_vpr_h(
 		"%s: dmabuf %pK, size %d, buffer_type %s, secure %d, region %d\n",
@@ -430,6 +567,7 @@ static int msm_vidc_memory_unmap_free(struct msm_vidc_core *core, struct msm_vid
 
 	dma_free_attrs(cb->dev, mem->size, mem->kvaddr, mem->device_addr,
 		mem->attrs);
+	atomic64_sub(ALIGN(mem->size, SZ_4K), &cb->iova_size);
 
 	mem->kvaddr = NULL;
 	mem->device_addr = 0;
@@ -474,6 +612,7 @@ static int msm_vidc_dma_map_page(struct msm_vidc_core *core,
 
 	mem->device_addr = dma_addr;
 	mem->refcount++;
+	atomic64_add(mem->size, &cb->iova_size);
 
 exit:
 	d_vpr_l(
@@ -523,6 +662,7 @@ static int msm_vidc_dma_unmap_page(struct msm_vidc_core *core,
 
 	dma_unmap_page(cb->dev, (dma_addr_t)(mem->device_addr),
 		mem->size, mem->direction);
+	atomic64_sub(mem->size, &cb->iova_size);
 
 	mem->device_addr = 0x0;
 
@@ -560,6 +700,7 @@ static int msm_vidc_iommu_map(struct msm_vidc_core *core, struct msm_vidc_mem *m
 			mem->device_addr, mem->size, rc);
 		return rc;
 	}
+	atomic64_add(mem->size, &cb->iova_size);
 
 	d_vpr_h("%s: phys_addr %#llx size %d device_addr %#llx, mem_region %d\n",
 		__func__, mem->phys_addr, mem->size, mem->device_addr, mem->region);
@@ -588,6 +729,7 @@ static int msm_vidc_iommu_unmap(struct msm_vidc_core *core, struct msm_vidc_mem
 		__func__, mem->phys_addr, mem->size, mem->device_addr, mem->region);
 
 	iommu_unmap(cb->domain, mem->device_addr, mem->size);
+	atomic64_sub(mem->size, &cb->iova_size);
 	mem->device_addr = 0x0;
 	mem->phys_addr = 0x0;
 	mem->size = 0;
@@ -41,6 +41,10 @@ const char video_banner[] = "Video-Banner: (" __stringify(VIDEO_COMPILE_BY) "@"
 
 static inline bool is_video_device(struct device *dev)
 {
+	if (IS_ENABLED(CONFIG_MSM_VIDC_SIM) &&
+	    of_device_is_compatible(dev->of_node, "qcom,qcm6490-iris-vpu-sim"))
+		return true;
+
 	return !!(of_device_is_compatible(dev->of_node, "qcom,sm8550-vidc") ||
 		of_device_is_compatible(dev->of_node, "qcom,qcm6490-iris-vpu") ||
 		of_device_is_compatible(dev->of_node, "qcom,sa8775p-iris") ||
@@ -115,6 +119,9 @@ static struct attribute_group msm_vidc_core_attr_group = {
 
 static const struct of_device_id msm_vidc_dt_match[] = {
 	{.compatible = "qcom,qcm6490-iris-vpu"},
+#ifdef CONFIG_MSM_VIDC_SIM
+	{.compatible = "qcom,qcm6490-iris-vpu-sim"},
+#endif
 	{.compatible = "qcom,sm8550-vidc"},
 	{.compatible = "qcom,sa8775p-iris"},
 	{.compatible = "qcom,qcs8300-iris"},
@@ -332,6 +339,19 @@ static int msm_vidc_deinitialize_core(struct msm_vidc_core *core)
 	}
 	d_vpr_h("%s()\n", __func__);
 
+	hrtimer_cancel(&core->doorbell_timer);
+	cancel_work_sync(&core->doorbell_work);
+
+	msm_vidc_mem_cache_deinit(core);
+
+	if (core->dbg_workq)
+		destroy_workqueue(core->dbg_workq);
+	core->dbg_workq = NULL;
+	if (kfifo_initialized(&core->dbg_fifo))
+		kfifo_free(&core->dbg_fifo);
+
+	msm_vidc_pool_caches_deinit(core);
+
 	mutex_destroy(&core->lock);
 	msm_vidc_update_core_state(core, MSM_VIDC_CORE_DEINIT, __func__);
 
@@ -369,6 +389,14 @@ static int msm_vidc_initialize_core(struct msm_vidc_core *core)
 		goto exit;
 	}
 
+	/* firmware logs are printed off the response path */
+	core->dbg_workq = alloc_ordered_workqueue("dbg_workq", 0);
+	if (!core->dbg_workq) {
+		d_vpr_e("%s: create dbg workq failed\n", __func__);
+		rc = -EINVAL;
+		goto exit;
+	}
+
 	core->packet_size = VIDC_IFACEQ_VAR_HUGE_PKT_SIZE;
 	core->packet = devm_kzalloc(&core->pdev->dev, core->packet_size, GFP_KERNEL);
 	if (!core->packet) {
@@ -384,20 +412,55 @@ static int msm_vidc_initialize_core(struct msm_vidc_core *core)
 		goto exit;
 	}
 
+	core->dbg_log = devm_kzalloc(&core->pdev->dev, core->packet_size, GFP_KERNEL);
+	if (!core->dbg_log) {
+		d_vpr_e("%s: failed to alloc core dbg log\n", __func__);
+		rc = -ENOMEM;
+		goto exit;
+	}
+
+	rc = kfifo_alloc(&core->dbg_fifo, VIDC_DBG_FIFO_SIZE, GFP_KERNEL);
+	if (rc) {
+		d_vpr_e("%s: failed to alloc dbg fifo\n", __func__);
+		goto exit;
+	}
+
+	rc = msm_vidc_pool_caches_init(core);
+	if (rc)
+		goto exit;
+
+	rc = msm_vidc_mem_cache_init(core);
+	if (rc)
+		goto exit;
+
 	mutex_init(&core->lock);
 	INIT_LIST_HEAD(&core->instances);
 	INIT_LIST_HEAD(&core->dangling_instances);
+	INIT_LIST_HEAD(&core->cmdq_backlog);
+	atomic64_set(&core->mem_usage, 0);
 
 	INIT_DELAYED_WORK(&core->pm_work, venus_hfi_pm_work_handler);
 	INIT_DELAYED_WORK(&core->fw_unload_work, msm_vidc_fw_unload_handler);
 	INIT_WORK(&core->ssr_work, msm_vidc_ssr_handler);
+	INIT_WORK(&core->doorbell_work, venus_hfi_doorbell_work_handler);
+	INIT_WORK(&core->dbg_work, venus_hfi_dbg_work_handler);
+	spin_lock_init(&core->hfi_latency.lock);
+	hrtimer_init(&core->doorbell_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	core->doorbell_timer.function = venus_hfi_doorbell_timer_handler;
 
 	return 0;
 exit:
+	/* in reverse order of init, each step is a no-op if it never ran */
+	msm_vidc_pool_caches_deinit(core);
+	if (kfifo_initialized(&core->dbg_fifo))
+		kfifo_free(&core->dbg_fifo);
+	if (core->dbg_workq)
+		destroy_workqueue(core->dbg_workq);
 	if (core->batch_workq)
 		destroy_workqueue(core->batch_workq);
 	if (core->pm_workq)
 		destroy_workqueue(core->pm_workq);
+	core->dbg_workq = NULL;
 	core->batch_workq = NULL;
 	core->pm_workq = NULL;
 
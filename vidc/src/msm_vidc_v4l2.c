@@ -12,6 +12,7 @@
 #include "msm_vidc_debug.h"
 #include "msm_vidc.h"
 #include "msm_vidc_events.h"
+#include "venus_hfi.h"
 
 extern struct msm_vidc_core *g_core;
 
@@ -797,7 +798,9 @@ int msm_v4l2_decoder_cmd(struct file *filp, void *fh,
 		goto unlock;
 	}
 	event = (dec->cmd == V4L2_DEC_CMD_START ? MSM_VIDC_CMD_START : MSM_VIDC_CMD_STOP);
+	venus_hfi_session_burst_begin(inst);
 	rc = inst->event_handle(inst, event, NULL);
+	venus_hfi_session_burst_end(inst);
 	if (rc)
 		goto unlock;
 
@@ -872,7 +875,9 @@ int msm_v4l2_encoder_cmd(struct file *filp, void *fh,
 		goto unlock;
 	}
 	event = (enc->cmd == V4L2_ENC_CMD_START ? MSM_VIDC_CMD_START : MSM_VIDC_CMD_STOP);
+	venus_hfi_session_burst_begin(inst);
 	rc = inst->event_handle(inst, event, NULL);
+	venus_hfi_session_burst_end(inst);
 	if (rc)
 		goto unlock;
 
@@ -15,6 +15,7 @@
 #include "msm_venc.h"
 #include "msm_vidc_control.h"
 #include "msm_vidc_platform.h"
+#include "venus_hfi.h"
 
 extern struct msm_vidc_core *g_core;
 
@@ -160,6 +161,12 @@ void *msm_vb2_attach_dmabuf(struct vb2_buffer *vb, struct device *dev,
 		}
 	}
 
+	/* reuse the mapping kept from an earlier attachment of this dmabuf */
+	if (msm_vidc_map_cache_get(inst, buf, dev)) {
+		print_vidc_buffer(VIDC_LOW, "low ", "attach: cached map", inst, buf);
+		goto exit;
+	}
+
 	buf->attach = call_mem_op(core, dma_buf_attach, core, dbuf, dev);
 	if (!buf->attach) {
 		buf->attach = NULL;
@@ -481,6 +488,15 @@ void msm_vb2_detach_dmabuf(void *buf_priv)
 		}
 	}
 
+	/* mapping handed over by the map cache that vb2 never used */
+	if (vbuf->sg_table) {
+		if (msm_vidc_map_cache_put(inst, vbuf))
+			goto exit;
+		msm_vidc_unmap_dmabuf(inst, vbuf->attach, vbuf->sg_table);
+		vbuf->sg_table = NULL;
+		vbuf->device_addr = 0x0;
+	}
+
 	print_vidc_buffer(VIDC_LOW, "low ", "detach", inst, vbuf);
 	if (vbuf->attach && vbuf->dmabuf) {
 		call_mem_op(core, dma_buf_detach, core, vbuf->dmabuf, vbuf->attach);
@@ -497,7 +513,6 @@ int msm_vb2_map_dmabuf(void *buf_priv)
 {
 	int rc = 0;
 	struct msm_vidc_buffer *buf = buf_priv;
-	struct msm_vidc_core *core;
 	struct msm_vidc_inst *inst;
 	struct msm_vidc_buffer *ro_buf, *dummy;
 
@@ -511,7 +526,6 @@ int msm_vb2_map_dmabuf(void *buf_priv)
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
-	core = inst->core;
 
 	if (is_decode_session(inst) && is_output_buffer(buf->type)) {
 		list_for_each_entry_safe(ro_buf, dummy, &inst->buffers.read_only.list, list) {
@@ -525,7 +539,18 @@ int msm_vb2_map_dmabuf(void *buf_priv)
 		}
 	}
 
-	buf->sg_table = call_mem_op(core, dma_buf_map_attachment, core, buf->attach);
+	/* attach already took the mapping over from the map cache */
+	if (buf->sg_table)
+		goto exit;
+
+	/* unmapped without a detach, the map cache owns the attachment */
+	if (!buf->attach) {
+		if (!msm_vidc_map_cache_get(inst, buf, NULL))
+			rc = -EINVAL;
+		goto exit;
+	}
+
+	buf->sg_table = msm_vidc_map_dmabuf(inst, buf->attach);
 	if (!buf->sg_table || !buf->sg_table->sgl) {
 		buf->sg_table = NULL;
 		rc = -ENOMEM;
@@ -545,7 +570,6 @@ void msm_vb2_unmap_dmabuf(void *buf_priv)
 {
 	struct msm_vidc_buffer *vbuf = buf_priv;
 	struct msm_vidc_buffer *ro_buf, *dummy;
-	struct msm_vidc_core *core;
 	struct msm_vidc_inst *inst;
 
 	if (!vbuf || !vbuf->inst) {
@@ -557,7 +581,6 @@ void msm_vb2_unmap_dmabuf(void *buf_priv)
 		d_vpr_e("%s: invalid params %pK\n", __func__, inst);
 		return;
 	}
-	core = inst->core;
 
 	if (is_decode_session(inst) && is_output_buffer(vbuf->type)) {
 		list_for_each_entry_safe(ro_buf, dummy, &inst->buffers.read_only.list, list) {
@@ -571,9 +594,14 @@ void msm_vb2_unmap_dmabuf(void *buf_priv)
 		}
 	}
 
+	if (msm_vidc_map_cache_put(inst, vbuf)) {
+		print_vidc_buffer(VIDC_LOW, "low ", "unmap: cached map", inst, vbuf);
+		goto exit;
+	}
+
 	print_vidc_buffer(VIDC_HIGH, "high", "unmap", inst, vbuf);
 	if (vbuf->attach && vbuf->sg_table) {
-		call_mem_op(core, dma_buf_unmap_attachment, core, vbuf->attach, vbuf->sg_table);
+		msm_vidc_unmap_dmabuf(inst, vbuf->attach, vbuf->sg_table);
 		vbuf->sg_table = NULL;
 		vbuf->device_addr = 0x0;
 	}
@@ -725,7 +753,10 @@ int msm_vb2_start_streaming(struct vb2_queue *q, unsigned int count)
 		return -EINVAL;
 	}
 
+	/* issue the whole streamon sequence to firmware at once */
+	venus_hfi_session_burst_begin(inst);
 	rc = inst->event_handle(inst, MSM_VIDC_STREAMON, q);
+	venus_hfi_session_burst_end(inst);
 	if (rc) {
 		i_vpr_e(inst, "Streamon: %s failed\n", v4l2_type_name(q->type));
 		msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
@@ -809,6 +840,10 @@ int msm_vidc_start_streaming(struct msm_vidc_inst *inst, struct vb2_queue *q)
 	/* print internal buffer memory usage stats */
 	msm_vidc_print_memory_stats(inst);
 
+	rc = msm_vidc_prealloc_pools(inst);
+	if (rc)
+		return rc;
+
 	buf_type = v4l2_type_to_driver(q->type, __func__);
 	if (!buf_type)
 		return -EINVAL;
@@ -873,7 +908,7 @@ int msm_vidc_stop_streaming(struct msm_vidc_inst *inst, struct vb2_queue *q)
 
 	/* Input port streamoff */
 	if (q->type == INPUT_MPLANE) {
-		/* flush timestamps list */
+		/* flush timestamps window */
 		msm_vidc_flush_ts(inst);
 
 		/* flush buffer_stats list */
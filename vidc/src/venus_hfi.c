@@ -29,6 +29,8 @@
 #include "msm_vidc_state.h"
 #include "firmware.h"
 
+#define MSGQ_BURST_SIZE				32
+#define MSGQ_POLL_INTERVAL_US			50
 #define update_offset(offset, val)		((offset) += (val))
 #define update_timestamp(ts, val) \
 	do { \
@@ -114,6 +116,10 @@ static void __flush_debug_queue(struct msm_vidc_core *core,
 	bool local_packet = false;
 	enum vidc_msg_prio_fw log_level_fw = msm_fw_debug;
 
+	/* print what the response path queued up first, keeps logs in order */
+	if (core->dbg_workq)
+		flush_work(&core->dbg_work);
+
 	if (!packet || !packet_size) {
 		packet = vzalloc(VIDC_IFACEQ_VAR_HUGE_PKT_SIZE);
 		if (!packet) {
@@ -161,6 +167,64 @@ static void __flush_debug_queue(struct msm_vidc_core *core,
 		vfree(packet);
 }
 
+/*
+ * Moves firmware log messages from the debug queue to the dbg fifo, they
+ * are formatted and printed later by venus_hfi_dbg_work_handler(). This
+ * keeps firmware logging out of the response path. Messages which do not
+ * fit into the fifo are dropped and accounted in dbg_dropped.
+ */
+static void __queue_debug_msgs(struct msm_vidc_core *core,
+	u8 *packet, u32 packet_size)
+{
+	struct hfi_debug_header *pkt;
+	u32 queued = 0, len;
+
+	if (!kfifo_initialized(&core->dbg_fifo)) {
+		__flush_debug_queue(core, packet, packet_size);
+		return;
+	}
+
+	while (!venus_hfi_queue_dbg_read(core, packet)) {
+		pkt = (struct hfi_debug_header *)packet;
+
+		if (pkt->size <= sizeof(struct hfi_debug_header) ||
+		    pkt->size >= packet_size) {
+			d_vpr_e("%s: invalid pkt size %d\n",
+				__func__, pkt->size);
+			continue;
+		}
+
+		/* skip the leading new line character, see __flush_debug_queue */
+		len = pkt->size - sizeof(struct hfi_debug_header) - 1;
+		if (!kfifo_in(&core->dbg_fifo,
+			      packet + sizeof(struct hfi_debug_header) + 1, len)) {
+			core->dbg_dropped++;
+			continue;
+		}
+		queued++;
+	}
+
+	if (queued) {
+		core->dbg_msg_count += queued;
+		queue_work(core->dbg_workq, &core->dbg_work);
+	}
+}
+
+void venus_hfi_dbg_work_handler(struct work_struct *work)
+{
+	struct msm_vidc_core *core;
+	u32 len;
+
+	core = container_of(work, struct msm_vidc_core, dbg_work);
+
+	while (!kfifo_is_empty(&core->dbg_fifo)) {
+		len = kfifo_out(&core->dbg_fifo, core->dbg_log,
+				core->packet_size - 1);
+		core->dbg_log[len] = '\0';
+		dprintk_firmware(msm_fw_debug, "%s", core->dbg_log);
+	}
+}
+
 static int __cmdq_write(struct msm_vidc_core *core, void *pkt)
 {
 	int rc;
@@ -191,6 +255,123 @@ static int __cmdq_write_intr(struct msm_vidc_core *core, void *pkt, bool allow_i
 	return rc;
 }
 
+static int __cmdq_write_deferred(struct msm_vidc_core *core, void *pkt)
+{
+	int rc;
+
+	rc = __resume(core);
+	if (rc)
+		return rc;
+
+	rc = venus_hfi_queue_cmd_write_deferred(core, pkt);
+	if (!rc)
+		__schedule_power_collapse_work(core);
+
+	return rc;
+}
+
+/*
+ * Writes the property packets batched so far in inst->prop_packet, see
+ * venus_hfi_session_prop_batch_begin(). Callers hold the core lock. Every
+ * other session packet goes through here first, so firmware still sees
+ * properties and commands in the order the driver issued them.
+ */
+static int __prop_batch_commit(struct msm_vidc_inst *inst)
+{
+	struct hfi_header *hdr = inst->prop_packet;
+	int rc;
+
+	if (!hdr || !hdr->num_packets)
+		return 0;
+
+	rc = hfi_update_packet_ids(inst->core, inst->prop_packet,
+			inst->packet_size);
+	if (!rc)
+		rc = __cmdq_write_intr(inst->core, inst->prop_packet,
+				!inst->hfi_burst);
+
+	hdr->num_packets = 0;
+	return rc;
+}
+
+/*
+ * Writes the session command staged in inst->packet, callers hold the
+ * core lock. The doorbell is held back while the session is in a command
+ * burst, see venus_hfi_session_burst_begin(). Commands which require a
+ * response are tracked until firmware acks them.
+ */
+static int __cmdq_write_inst(struct msm_vidc_inst *inst)
+{
+	struct hfi_packet *pkt;
+	bool track;
+	int rc;
+
+	rc = __prop_batch_commit(inst);
+	if (rc)
+		return rc;
+
+	/* batch went out first, re-stamp so ids stay monotonic in queue order */
+	rc = hfi_update_packet_ids(inst->core, inst->packet, inst->packet_size);
+	if (rc)
+		return rc;
+
+	/* track before writing, a response must never find an untracked id */
+	pkt = (struct hfi_packet *)(inst->packet + sizeof(struct hfi_header));
+	track = pkt->flags & HFI_HOST_FLAGS_RESPONSE_REQUIRED;
+	if (track)
+		msm_vidc_track_session_cmd(inst, pkt->type, pkt->port,
+					   pkt->packet_id);
+
+	rc = __cmdq_write_intr(inst->core, inst->packet, !inst->hfi_burst);
+	if (rc && track)
+		msm_vidc_session_cmd_done(inst, pkt->type, pkt->port,
+					  pkt->packet_id);
+
+	return rc;
+}
+
+/*
+ * Commit a session packet staged in inst->packet to the command queue.
+ * inst->packet is protected by inst->lock, so callers build the header
+ * and packets without core->lock and only the final header/packet id
+ * assignment and the queue write are serialized across sessions here.
+ * With defer_intr set, the doorbell is coalesced with other buffer
+ * packets as per venus_hfi_queue_cmd_write_deferred().
+ */
+static int __cmdq_write_session(struct msm_vidc_inst *inst, bool allow_intr,
+	bool defer_intr)
+{
+	struct msm_vidc_core *core = inst->core;
+	int rc = 0;
+
+	core_lock(core, __func__);
+	if (!__valdiate_session(core, inst, __func__)) {
+		rc = -EINVAL;
+		goto unlock;
+	}
+
+	rc = __prop_batch_commit(inst);
+	if (rc)
+		goto unlock;
+
+	rc = hfi_update_packet_ids(core, inst->packet, inst->packet_size);
+	if (rc)
+		goto unlock;
+
+	/* the whole burst is announced with one doorbell at its end */
+	if (inst->hfi_burst)
+		allow_intr = false;
+
+	if (allow_intr && defer_intr)
+		rc = __cmdq_write_deferred(core, inst->packet);
+	else
+		rc = __cmdq_write_intr(core, inst->packet, allow_intr);
+
+unlock:
+	core_unlock(core, __func__);
+	return rc;
+}
+
 static int __sys_set_debug(struct msm_vidc_core *core, u32 debug)
 {
 	int rc = 0;
@@ -277,6 +458,17 @@ static int __power_collapse(struct msm_vidc_core *core, bool force)
 		return -EINVAL;
 	}
 
+	/*
+	 * commands behind a deferred doorbell are not seen by firmware
+	 * yet, announce them while registers are still powered and let
+	 * firmware process them before trying again.
+	 */
+	if (core->doorbell_pending) {
+		venus_hfi_queue_flush_doorbell(core);
+		if (!force)
+			return -EBUSY;
+	}
+
 	__flush_debug_queue(core, (!force ? core->packet : NULL), core->packet_size);
 
 	rc = call_venus_op(core, prepare_pc, core);
@@ -310,7 +502,7 @@ static int __release_subcaches(struct msm_vidc_core *core)
 	}
 
 	rc = hfi_create_header(core->packet, core->packet_size,
-		0, core->header_id++);
+		0, 0);
 	if (rc)
 		return rc;
 
@@ -331,13 +523,17 @@ static int __release_subcaches(struct msm_vidc_core *core)
 			HFI_BUF_HOST_FLAG_NONE,
 			HFI_PAYLOAD_STRUCTURE,
 			HFI_PORT_NONE,
-			core->packet_id++,
+			0,
 			&buf,
 			sizeof(buf));
 		if (rc)
 			return rc;
 	}
 
+	rc = hfi_update_packet_ids(core, core->packet, core->packet_size);
+	if (rc)
+		return rc;
+
 	/* Set resource to Venus for activated subcaches */
 	rc = __cmdq_write(core, core->packet);
 	if (rc)
@@ -373,7 +569,7 @@ static int __set_subcaches(struct msm_vidc_core *core)
 	}
 
 	rc = hfi_create_header(core->packet, core->packet_size,
-		0, core->header_id++);
+		0, 0);
 	if (rc)
 		goto err_fail_set_subacaches;
 
@@ -393,13 +589,17 @@ static int __set_subcaches(struct msm_vidc_core *core)
 			HFI_BUF_HOST_FLAG_NONE,
 			HFI_PAYLOAD_STRUCTURE,
 			HFI_PORT_NONE,
-			core->packet_id++,
+			0,
 			&buf,
 			sizeof(buf));
 		if (rc)
 			goto err_fail_set_subacaches;
 	}
 
+	rc = hfi_update_packet_ids(core, core->packet, core->packet_size);
+	if (rc)
+		goto err_fail_set_subacaches;
+
 	/* Set resource to Venus for activated subcaches */
 	rc = __cmdq_write(core, core->packet);
 	if (rc)
@@ -625,10 +825,47 @@ static void __unload_fw(struct msm_vidc_core *core)
 	d_vpr_h("%s unloaded video firmware\n", __func__);
 }
 
-static int __response_handler(struct msm_vidc_core *core)
+static u32 __drain_msg_queue(struct msm_vidc_core *core, bool rx_req)
 {
+	u32 start_idx, read_idx, pkt_size, burst = 0, count = 0;
+	u8 *pkt;
 	int rc = 0;
 
+	if (venus_hfi_queue_msg_begin(core, &start_idx))
+		return 0;
+
+	/*
+	 * Messages are parsed in place from the msgq ring and the read index
+	 * is advanced once per burst of MSGQ_BURST_SIZE messages.
+	 */
+	read_idx = start_idx;
+	while (!venus_hfi_queue_msg_peek(core, &read_idx,
+			core->response_packet, &pkt, &pkt_size)) {
+		rc = handle_response(core, pkt, pkt_size);
+		count++;
+		if (++burst == MSGQ_BURST_SIZE) {
+			venus_hfi_queue_msg_commit(core, start_idx, read_idx, rx_req);
+			start_idx = read_idx;
+			burst = 0;
+		}
+		if (rc)
+			continue;
+		/* check for system error */
+		if (core->state != MSM_VIDC_CORE_INIT)
+			break;
+	}
+	/* also re-arms rx_req when the queue was found empty */
+	venus_hfi_queue_msg_commit(core, start_idx, read_idx, rx_req);
+
+	return count;
+}
+
+static int __response_handler(struct msm_vidc_core *core)
+{
+	u32 num, total = 0;
+	ktime_t deadline;
+	bool polling;
+
 	if (call_venus_op(core, watchdog, core, core->intr_status)) {
 		struct hfi_packet pkt = {.type = HFI_SYS_ERROR_WD_TIMEOUT};
 
@@ -640,24 +877,46 @@ static int __response_handler(struct msm_vidc_core *core)
 		d_vpr_e("%s: CPU WD error received\n", __func__);
 		core_unlock(core, __func__);
 
-		return handle_system_error(core, &pkt);
+		handle_system_error(core, &pkt);
+		return 0;
 	}
 
-	memset(core->response_packet, 0, core->packet_size);
-	while (!venus_hfi_queue_msg_read(core, core->response_packet)) {
-		rc = handle_response(core, core->response_packet);
-		if (rc)
-			continue;
-		/* check for system error */
-		if (core->state != MSM_VIDC_CORE_INIT)
-			break;
-		memset(core->response_packet, 0, core->packet_size);
+	/*
+	 * In polling mode keep firmware from interrupting (rx_req = 0) and
+	 * poll the msgq for as long as messages keep arriving, bounded by
+	 * msm_vidc_poll_budget messages and msm_vidc_poll_time_us. rx_req is
+	 * re-armed by the final drain, which also picks up any message that
+	 * raced with it.
+	 */
+	polling = msm_vidc_poll_time_us && msm_vidc_poll_budget;
+	deadline = ktime_add_us(ktime_get(), msm_vidc_poll_time_us);
+
+	num = __drain_msg_queue(core, !polling);
+	total += num;
+	while (polling && num && total < msm_vidc_poll_budget &&
+	       core->state == MSM_VIDC_CORE_INIT &&
+	       ktime_before(ktime_get(), deadline)) {
+		usleep_range(MSGQ_POLL_INTERVAL_US, MSGQ_POLL_INTERVAL_US * 2);
+		core->poll_count++;
+		num = __drain_msg_queue(core, false);
+		total += num;
+	}
+	if (polling)
+		total += __drain_msg_queue(core, true);
+
+	core->msg_count += total;
+
+	/* firmware made room in the cmd queue, write out parked packets */
+	if (READ_ONCE(core->cmdq_backlog_count)) {
+		core_lock(core, __func__);
+		venus_hfi_queue_cmd_backlog_flush(core);
+		core_unlock(core, __func__);
 	}
 
 	__schedule_power_collapse_work(core);
-	__flush_debug_queue(core, core->response_packet, core->packet_size);
+	__queue_debug_msgs(core, core->response_packet, core->packet_size);
 
-	return rc;
+	return total;
 }
 
 irqreturn_t venus_hfi_isr(int irq, void *data)
@@ -669,7 +928,6 @@ irqreturn_t venus_hfi_isr(int irq, void *data)
 irqreturn_t venus_hfi_isr_handler(int irq, void *data)
 {
 	struct msm_vidc_core *core = data;
-	int num_responses = 0, rc = 0;
 
 	d_vpr_l("%s: received interrupt from hardware\n", __func__);
 
@@ -678,23 +936,35 @@ irqreturn_t venus_hfi_isr_handler(int irq, void *data)
 		return IRQ_NONE;
 	}
 
+	venus_hfi_process_responses(core);
+
+	if (!call_venus_op(core, watchdog, core, core->intr_status))
+		enable_irq(irq);
+
+	return IRQ_HANDLED;
+}
+
+/*
+ * Handles one firmware interrupt worth of responses. Called from the
+ * threaded irq handler, or directly by variants which do not deliver
+ * interrupts through the irq line (e.g. the sim variant).
+ */
+int venus_hfi_process_responses(struct msm_vidc_core *core)
+{
+	int rc = 0;
+
 	core_lock(core, __func__);
 	rc = __resume(core);
 	if (rc) {
 		d_vpr_e("%s: Power on failed\n", __func__);
 		core_unlock(core, __func__);
-		goto exit;
+		return rc;
 	}
 	call_venus_op(core, clear_interrupt, core);
 	core_unlock(core, __func__);
 
-	num_responses = __response_handler(core);
-
-exit:
-	if (!call_venus_op(core, watchdog, core, core->intr_status))
-		enable_irq(irq);
-
-	return IRQ_HANDLED;
+	core->intr_count++;
+	return __response_handler(core);
 }
 
 void venus_hfi_pm_work_handler(struct work_struct *work)
@@ -757,6 +1027,29 @@ unlock:
 	core_unlock(core, __func__);
 }
 
+enum hrtimer_restart venus_hfi_doorbell_timer_handler(struct hrtimer *timer)
+{
+	struct msm_vidc_core *core;
+
+	core = container_of(timer, struct msm_vidc_core, doorbell_timer);
+
+	/* raising the interrupt needs core->lock, defer it to process context */
+	queue_work(core->batch_workq, &core->doorbell_work);
+
+	return HRTIMER_NORESTART;
+}
+
+void venus_hfi_doorbell_work_handler(struct work_struct *work)
+{
+	struct msm_vidc_core *core;
+
+	core = container_of(work, struct msm_vidc_core, doorbell_work);
+
+	core_lock(core, __func__);
+	venus_hfi_queue_flush_doorbell(core);
+	core_unlock(core, __func__);
+}
+
 static int __sys_init(struct msm_vidc_core *core)
 {
 	int rc = 0;
@@ -942,7 +1235,7 @@ int venus_hfi_trigger_ssr(struct msm_vidc_core *core, u32 type,
 
 	rc = hfi_create_header(core->packet, core->packet_size,
 			   0 /*session_id*/,
-			   core->header_id++);
+			   0);
 	if (rc)
 		goto exit;
 
@@ -953,11 +1246,15 @@ int venus_hfi_trigger_ssr(struct msm_vidc_core *core, u32 type,
 				   HFI_HOST_FLAGS_INTR_REQUIRED,
 				   HFI_PAYLOAD_U64,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload, sizeof(u64));
 	if (rc)
 		goto exit;
 
+	rc = hfi_update_packet_ids(core, core->packet, core->packet_size);
+	if (rc)
+		goto exit;
+
 	rc = __cmdq_write(core, core->packet);
 	if (rc)
 		goto exit;
@@ -990,8 +1287,10 @@ int venus_hfi_trigger_stability(struct msm_vidc_inst *inst, u32 type,
 
 	payload[0] = client_id << 4 | type;
 	payload[1] = val;
+
+	/* header and packet ids are assigned at commit time */
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-			   inst->session_id, core->header_id++);
+			   inst->session_id, 0);
 	if (rc)
 		goto unlock;
 
@@ -1002,12 +1301,12 @@ int venus_hfi_trigger_stability(struct msm_vidc_inst *inst, u32 type,
 				   HFI_HOST_FLAGS_INTR_REQUIRED,
 				   HFI_PAYLOAD_U64,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload, sizeof(u64));
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1039,8 +1338,9 @@ int venus_hfi_reserve_hardware(struct msm_vidc_inst *inst, u32 duration)
 	else
 		payload = HFI_RESERVE_STOP;
 
+	/* header and packet ids are assigned at commit time */
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-		inst->session_id, core->header_id++);
+		inst->session_id, 0);
 	if (rc)
 		goto unlock;
 
@@ -1049,12 +1349,12 @@ int venus_hfi_reserve_hardware(struct msm_vidc_inst *inst, u32 duration)
 		HFI_HOST_FLAGS_NONE,
 		HFI_PAYLOAD_U32_ENUM,
 		HFI_PORT_NONE,
-		core->packet_id++,
+		0,
 		&payload, sizeof(u32));
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1063,6 +1363,37 @@ unlock:
 	return rc;
 }
 
+/*
+ * Session command bursts: between begin and end, session commands,
+ * properties and buffers are written to the cmd queue back to back
+ * without raising the doorbell, so firmware picks up e.g. a whole
+ * streamon sequence at once instead of one command per interrupt.
+ * Bursts nest, the doorbell is raised when the outermost one ends.
+ * Callers hold the inst lock.
+ */
+void venus_hfi_session_burst_begin(struct msm_vidc_inst *inst)
+{
+	inst->hfi_burst++;
+}
+
+/* raises the doorbell for commands written so far in the current burst */
+void venus_hfi_session_burst_flush(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_core *core = inst->core;
+
+	core_lock(core, __func__);
+	venus_hfi_queue_flush_doorbell(core);
+	core_unlock(core, __func__);
+}
+
+void venus_hfi_session_burst_end(struct msm_vidc_inst *inst)
+{
+	if (!inst->hfi_burst || --inst->hfi_burst)
+		return;
+
+	venus_hfi_session_burst_flush(inst);
+}
+
 int venus_hfi_session_open(struct msm_vidc_inst *inst)
 {
 	int rc = 0;
@@ -1094,7 +1425,7 @@ int venus_hfi_session_open(struct msm_vidc_inst *inst)
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1121,8 +1452,9 @@ int venus_hfi_session_set_codec(struct msm_vidc_inst *inst)
 		goto unlock;
 	}
 
+	/* header and packet ids are assigned at commit time */
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-			inst->session_id, core->header_id++);
+			inst->session_id, 0);
 	if (rc)
 		goto unlock;
 
@@ -1132,13 +1464,13 @@ int venus_hfi_session_set_codec(struct msm_vidc_inst *inst)
 			HFI_HOST_FLAGS_NONE,
 			HFI_PAYLOAD_U32_ENUM,
 			HFI_PORT_NONE,
-			core->packet_id++,
+			0,
 			&codec,
 			sizeof(u32));
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1165,8 +1497,9 @@ int venus_hfi_session_set_secure_mode(struct msm_vidc_inst *inst)
 		goto unlock;
 	}
 
+	/* header and packet ids are assigned at commit time */
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-			inst->session_id, core->header_id++);
+			inst->session_id, 0);
 	if (rc)
 		goto unlock;
 
@@ -1176,13 +1509,13 @@ int venus_hfi_session_set_secure_mode(struct msm_vidc_inst *inst)
 			HFI_HOST_FLAGS_NONE,
 			HFI_PAYLOAD_U32,
 			HFI_PORT_NONE,
-			core->packet_id++,
+			0,
 			&secure_mode,
 			sizeof(u32));
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1230,53 +1563,135 @@ static int venus_hfi_cache_packet(struct msm_vidc_inst *inst)
 	return rc;
 }
 
+static int __prop_batch_write(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_core *core = inst->core;
+	int rc = 0;
+
+	core_lock(core, __func__);
+	if (!__valdiate_session(core, inst, __func__)) {
+		rc = -EINVAL;
+		goto unlock;
+	}
+
+	rc = __prop_batch_commit(inst);
+
+unlock:
+	core_unlock(core, __func__);
+	return rc;
+}
+
+static int __prop_batch_add(struct msm_vidc_inst *inst,
+	u32 pkt_type, u32 flags, u32 port, u32 payload_type,
+	void *payload, u32 payload_size)
+{
+	struct hfi_header *hdr = inst->prop_packet;
+	u32 pkt_size = sizeof(struct hfi_packet) + payload_size;
+	int rc = 0;
+
+	/* split the batch when the next property does not fit anymore */
+	if (hdr->num_packets && hdr->size + pkt_size > inst->packet_size) {
+		rc = __prop_batch_write(inst);
+		if (rc)
+			return rc;
+	}
+
+	if (!hdr->num_packets) {
+		rc = hfi_create_header(inst->prop_packet, inst->packet_size,
+					inst->session_id, 0);
+		if (rc)
+			return rc;
+	}
+
+	return hfi_create_packet(inst->prop_packet, inst->packet_size,
+				pkt_type,
+				flags,
+				payload_type,
+				port,
+				0,
+				payload,
+				payload_size);
+}
+
+/*
+ * Property batches: between begin and end, HFI_CMD_PROPERTY packets set
+ * via venus_hfi_session_property() are collected behind a single
+ * hfi_header and written to the cmd queue as one message, e.g. all the
+ * v4l2 controls applied at streamon. A batch is written early when it
+ * reaches inst->packet_size or when any other session packet is issued.
+ * Batches nest like command bursts and callers hold the inst lock.
+ */
+void venus_hfi_session_prop_batch_begin(struct msm_vidc_inst *inst)
+{
+	if (!inst->prop_packet)
+		return;
+
+	inst->prop_batch++;
+}
+
+int venus_hfi_session_prop_batch_end(struct msm_vidc_inst *inst)
+{
+	if (!inst->prop_batch || --inst->prop_batch)
+		return 0;
+
+	return __prop_batch_write(inst);
+}
+
+/*
+ * Ends a batch whose properties failed to be set, dropping those not
+ * written yet so firmware never sees half of the batch at its end.
+ */
+void venus_hfi_session_prop_batch_abort(struct msm_vidc_inst *inst)
+{
+	struct hfi_header *hdr = inst->prop_packet;
+
+	if (!inst->prop_batch)
+		return;
+
+	inst->prop_batch--;
+	if (hdr && hdr->num_packets) {
+		i_vpr_h(inst, "%s: dropping %u properties\n", __func__,
+			hdr->num_packets);
+		hdr->num_packets = 0;
+	}
+}
+
 int venus_hfi_session_property(struct msm_vidc_inst *inst,
 	u32 pkt_type, u32 flags, u32 port, u32 payload_type,
 	void *payload, u32 payload_size)
 {
 	int rc = 0;
-	struct msm_vidc_core *core;
 
 	if (!inst->packet) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
-	core = inst->core;
-	core_lock(core, __func__);
 
-	if (!__valdiate_session(core, inst, __func__)) {
-		rc = -EINVAL;
-		goto unlock;
-	}
+	/* header and packet ids are assigned at commit time */
+	if (inst->prop_batch && !inst->request)
+		return __prop_batch_add(inst, pkt_type, flags, port,
+				payload_type, payload, payload_size);
 
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-				inst->session_id, core->header_id++);
+				inst->session_id, 0);
 	if (rc)
-		goto unlock;
+		return rc;
 	rc = hfi_create_packet(inst->packet, inst->packet_size,
 				pkt_type,
 				flags,
 				payload_type,
 				port,
-				core->packet_id++,
+				0,
 				payload,
 				payload_size);
 	if (rc)
-		goto unlock;
+		return rc;
 
 	/* skip sending packet to firmware */
-	if (inst->request) {
-		rc = venus_hfi_cache_packet(inst);
-		goto unlock;
-	}
-
-	rc = __cmdq_write(inst->core, inst->packet);
-	if (rc)
-		goto unlock;
+	if (inst->request)
+		return venus_hfi_cache_packet(inst);
 
-unlock:
-	core_unlock(core, __func__);
-	return rc;
+	return __cmdq_write_session(inst, true, false);
 }
 
 int venus_hfi_session_close(struct msm_vidc_inst *inst)
@@ -1309,7 +1724,7 @@ int venus_hfi_session_close(struct msm_vidc_inst *inst)
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1352,7 +1767,7 @@ int venus_hfi_start(struct msm_vidc_inst *inst, enum msm_vidc_port_type port)
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1396,7 +1811,7 @@ int venus_hfi_stop(struct msm_vidc_inst *inst, enum msm_vidc_port_type port)
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1439,7 +1854,7 @@ int venus_hfi_session_pause(struct msm_vidc_inst *inst, enum msm_vidc_port_type
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1483,7 +1898,7 @@ int venus_hfi_session_resume(struct msm_vidc_inst *inst,
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1527,7 +1942,7 @@ int venus_hfi_session_drain(struct msm_vidc_inst *inst, enum msm_vidc_port_type
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1555,9 +1970,9 @@ int venus_hfi_session_command(struct msm_vidc_inst *inst,
 		goto unlock;
 	}
 
+	/* header and packet ids are assigned at commit time */
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-			inst->session_id,
-			core->header_id++);
+			inst->session_id, 0);
 	if (rc)
 		goto unlock;
 
@@ -1567,13 +1982,13 @@ int venus_hfi_session_command(struct msm_vidc_inst *inst,
 			HFI_HOST_FLAGS_INTR_REQUIRED),
 			payload_type,
 			get_hfi_port(inst, port),
-			core->packet_id++,
+			0,
 			payload,
 			payload_size);
 	if (rc)
 		goto unlock;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc)
 		goto unlock;
 
@@ -1597,23 +2012,17 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 		return -EINVAL;
 	}
 	core = inst->core;
-	core_lock(core, __func__);
-
-	if (!__valdiate_session(core, inst, __func__)) {
-		rc = -EINVAL;
-		goto unlock;
-	}
 
 	/* Get super yuv buffer */
 	rc = get_hfi_buffer(inst, buffer, &hfi_buffer);
 	if (rc)
-		goto unlock;
+		goto exit;
 
 	/* Get super meta buffer */
 	if (metabuf) {
 		rc = get_hfi_buffer(inst, metabuf, &hfi_meta_buffer);
 		if (rc)
-			goto unlock;
+			goto exit;
 	}
 
 	batch_size = inst->capabilities[SUPER_FRAME].value;
@@ -1625,14 +2034,14 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 	if (frame_size * batch_size != buffer->buffer_size) {
 		i_vpr_e(inst, "%s: invalid super yuv buffer. frame %u, batch %u, buffer size %u\n",
 			__func__, frame_size, batch_size, buffer->buffer_size);
-		goto unlock;
+		goto exit;
 	}
 
 	/* Sanitize super meta buffer */
 	if (metabuf && meta_size * batch_size > metabuf->buffer_size) {
 		i_vpr_e(inst, "%s: invalid super meta buffer. meta %u, batch %u, buffer size %u\n",
 			__func__, meta_size, batch_size, metabuf->buffer_size);
-		goto unlock;
+		goto exit;
 	}
 
 	/* Initialize yuv buffer */
@@ -1646,11 +2055,11 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 	}
 
 	while (cnt < batch_size) {
-		/* Create header */
+		/* Create header, ids are assigned at commit time */
 		rc = hfi_create_header(inst->packet, inst->packet_size,
-				inst->session_id, core->header_id++);
+				inst->session_id, 0);
 		if (rc)
-			goto unlock;
+			goto exit;
 
 		/* Create yuv packet */
 		update_offset(hfi_buffer.addr_offset, (cnt ? frame_size : 0u));
@@ -1661,11 +2070,11 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 				HFI_HOST_FLAGS_INTR_REQUIRED,
 				HFI_PAYLOAD_STRUCTURE,
 				get_hfi_port_from_buffer_type(inst, buffer->type),
-				core->packet_id++,
+				0,
 				&hfi_buffer,
 				sizeof(hfi_buffer));
 		if (rc)
-			goto unlock;
+			goto exit;
 
 		/* Create meta packet */
 		if (metabuf) {
@@ -1677,26 +2086,24 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 				HFI_HOST_FLAGS_INTR_REQUIRED,
 				HFI_PAYLOAD_STRUCTURE,
 				get_hfi_port_from_buffer_type(inst, metabuf->type),
-				core->packet_id++,
+				0,
 				&hfi_meta_buffer,
 				sizeof(hfi_meta_buffer));
 			if (rc)
-				goto unlock;
+				goto exit;
 		}
 
 		/* Raise interrupt only for last pkt in the batch */
-		rc = __cmdq_write_intr(inst->core, inst->packet,
-				       (cnt == batch_size - 1));
+		rc = __cmdq_write_session(inst, (cnt == batch_size - 1), true);
 		if (rc)
-			goto unlock;
+			goto exit;
 
 		/* update start timestamp */
 		msm_vidc_add_buffer_stats(inst, buffer, hfi_buffer.timestamp);
 
 		cnt++;
 	}
-unlock:
-	core_unlock(core, __func__);
+exit:
 	if (rc)
 		i_vpr_e(inst, "%s: queue super buffer failed: %d\n", __func__, rc);
 
@@ -1747,33 +2154,54 @@ static int venus_hfi_add_pending_packets(struct msm_vidc_inst *inst)
 	return rc;
 }
 
+/*
+ * Backpressure for buffers: true while the session has its share of
+ * command packets parked on the host because the cmd queue is full.
+ */
+bool venus_hfi_session_backlogged(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_core *core = inst->core;
+	bool backlogged;
+
+	if (!READ_ONCE(core->cmdq_backlog_count))
+		return false;
+
+	core_lock(core, __func__);
+	backlogged = venus_hfi_queue_cmd_backlogged(core, inst);
+	core_unlock(core, __func__);
+
+	return backlogged;
+}
+
+void venus_hfi_session_backlog_drop(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_core *core = inst->core;
+
+	core_lock(core, __func__);
+	venus_hfi_queue_cmd_backlog_drop(core, inst);
+	core_unlock(core, __func__);
+}
+
 int venus_hfi_queue_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buffer, struct msm_vidc_buffer *metabuf)
 {
 	int rc = 0;
-	struct msm_vidc_core *core;
 	struct hfi_buffer hfi_buffer, hfi_meta_buffer;
 
 	if (!inst->packet) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
-	core = inst->core;
-	core_lock(core, __func__);
-
-	if (!__valdiate_session(core, inst, __func__)) {
-		rc = -EINVAL;
-		goto unlock;
-	}
 
 	rc = get_hfi_buffer(inst, buffer, &hfi_buffer);
 	if (rc)
-		goto unlock;
+		return rc;
 
+	/* header and packet ids are assigned at commit time */
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-			   inst->session_id, core->header_id++);
+			   inst->session_id, 0);
 	if (rc)
-		goto unlock;
+		return rc;
 
 	rc = hfi_create_packet(inst->packet,
 			inst->packet_size,
@@ -1781,35 +2209,34 @@ int venus_hfi_queue_buffer(struct msm_vidc_inst *inst,
 			HFI_HOST_FLAGS_INTR_REQUIRED,
 			HFI_PAYLOAD_STRUCTURE,
 			get_hfi_port_from_buffer_type(inst, buffer->type),
-			core->packet_id++,
+			0,
 			&hfi_buffer,
 			sizeof(hfi_buffer));
 	if (rc)
-		goto unlock;
+		return rc;
 
 	if (metabuf) {
 		rc = get_hfi_buffer(inst, metabuf, &hfi_meta_buffer);
 		if (rc)
-			goto unlock;
+			return rc;
 		rc = hfi_create_packet(inst->packet,
 			inst->packet_size,
 			HFI_CMD_BUFFER,
 			HFI_HOST_FLAGS_INTR_REQUIRED,
 			HFI_PAYLOAD_STRUCTURE,
 			get_hfi_port_from_buffer_type(inst, metabuf->type),
-			core->packet_id++,
+			0,
 			&hfi_meta_buffer,
 			sizeof(hfi_meta_buffer));
 		if (rc)
-			goto unlock;
+			return rc;
 	}
 
 	if (is_meta_rx_inp_enabled(inst, META_OUTBUF_FENCE) &&
 		is_output_buffer(buffer->type)) {
 		if (!buffer->fence_id) {
 			i_vpr_e(inst, "%s: fence id cannot be 0\n", __func__);
-			rc = -EINVAL;
-			goto unlock;
+			return -EINVAL;
 		}
 		rc = hfi_create_packet(inst->packet,
 			inst->packet_size,
@@ -1817,26 +2244,24 @@ int venus_hfi_queue_buffer(struct msm_vidc_inst *inst,
 			0,
 			HFI_PAYLOAD_U64,
 			HFI_PORT_RAW,
-			core->packet_id++,
+			0,
 			&buffer->fence_id,
 			sizeof(u64));
 		if (rc)
-			goto unlock;
+			return rc;
 	}
 
 	rc = venus_hfi_add_pending_packets(inst);
 	if (rc)
-		goto unlock;
+		return rc;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_session(inst, true, true);
 	if (rc)
-		goto unlock;
+		return rc;
 
 	/* update start timestamp */
 	msm_vidc_add_buffer_stats(inst, buffer, hfi_buffer.timestamp);
 
-unlock:
-	core_unlock(core, __func__);
 	return rc;
 }
 
@@ -1844,32 +2269,24 @@ int venus_hfi_release_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buffer)
 {
 	int rc = 0;
-	struct msm_vidc_core *core;
 	struct hfi_buffer hfi_buffer;
 
 	if (!inst->packet || !buffer) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
-	core = inst->core;
-	core_lock(core, __func__);
-
-	if (!__valdiate_session(core, inst, __func__)) {
-		rc = -EINVAL;
-		goto unlock;
-	}
 
 	rc = get_hfi_buffer(inst, buffer, &hfi_buffer);
 	if (rc)
-		goto unlock;
+		return rc;
 
 	/* add release flag */
 	hfi_buffer.flags |= HFI_BUF_HOST_FLAG_RELEASE;
 
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-			   inst->session_id, core->header_id++);
+			   inst->session_id, 0);
 	if (rc)
-		goto unlock;
+		return rc;
 
 	rc = hfi_create_packet(inst->packet,
 			inst->packet_size,
@@ -1878,19 +2295,13 @@ int venus_hfi_release_buffer(struct msm_vidc_inst *inst,
 			HFI_HOST_FLAGS_INTR_REQUIRED),
 			HFI_PAYLOAD_STRUCTURE,
 			get_hfi_port_from_buffer_type(inst, buffer->type),
-			core->packet_id++,
+			0,
 			&hfi_buffer,
 			sizeof(hfi_buffer));
 	if (rc)
-		goto unlock;
-
-	rc = __cmdq_write(inst->core, inst->packet);
-	if (rc)
-		goto unlock;
+		return rc;
 
-unlock:
-	core_unlock(core, __func__);
-	return rc;
+	return __cmdq_write_session(inst, true, false);
 }
 
 int venus_hfi_scale_clocks(struct msm_vidc_inst *inst, u64 freq)
@@ -1952,8 +2363,9 @@ int venus_hfi_set_ir_period(struct msm_vidc_inst *inst, u32 ir_type,
 
 	ir_period = inst->capabilities[cap_id].value;
 
+	/* header and packet ids are assigned at commit time */
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-			       inst->session_id, core->header_id++);
+			       inst->session_id, 0);
 	if (rc)
 		goto exit;
 
@@ -1967,7 +2379,7 @@ int venus_hfi_set_ir_period(struct msm_vidc_inst *inst, u32 ir_type,
 					       HFI_HOST_FLAGS_NONE,
 					       HFI_PAYLOAD_U32_ENUM,
 					       msm_vidc_get_port_info(inst, REQUEST_I_FRAME),
-					       core->packet_id++,
+					       0,
 					       &sync_frame_req,
 					       sizeof(u32));
 			if (rc)
@@ -1980,13 +2392,13 @@ int venus_hfi_set_ir_period(struct msm_vidc_inst *inst, u32 ir_type,
 			       HFI_HOST_FLAGS_NONE,
 			       HFI_PAYLOAD_U32,
 			       msm_vidc_get_port_info(inst, cap_id),
-			       core->packet_id++,
+			       0,
 			       &ir_period,
 			       sizeof(u32));
 	if (rc)
 		goto exit;
 
-	rc = __cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write_inst(inst);
 	if (rc) {
 		i_vpr_e(inst, "%s: failed to set inst->capabilities[%d] %s to fw\n",
 			__func__, cap_id, cap_name(cap_id));
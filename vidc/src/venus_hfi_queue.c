@@ -6,12 +6,20 @@
 
 #include "venus_hfi.h"
 #include "venus_hfi_queue.h"
+#include "hfi_command.h"
 
 #include "msm_vidc_core.h"
 #include "msm_vidc_debug.h"
 #include "msm_vidc_memory.h"
 #include "msm_vidc_platform.h"
 
+/* command packet parked on the host while the cmd queue is full */
+struct cmdq_backlog_entry {
+	struct list_head list;
+	struct msm_vidc_inst *inst; /* NULL for system packets */
+	u8 packet[];
+};
+
 static void __set_queue_hdr_defaults(struct hfi_queue_header *q_hdr)
 {
 	q_hdr->qhdr_status = 0x1;
@@ -56,6 +64,111 @@ static void __dump_packet(u8 *packet, const char *function, void *qinfo)
 	}
 }
 
+static u32 __queue_used_words(struct msm_vidc_iface_q_info *qinfo,
+	u32 read_idx, u32 write_idx)
+{
+	return (write_idx >= read_idx) ? (write_idx - read_idx) :
+		((qinfo->q_array.mem_size >> 2) - (read_idx - write_idx));
+}
+
+static void __update_queue_stats(struct msm_vidc_iface_q_info *qinfo,
+	u32 packet_size, u32 used_words)
+{
+	struct msm_vidc_iface_q_stats *stats = &qinfo->stats;
+
+	stats->packets++;
+	stats->bytes += packet_size;
+	if (used_words > stats->max_used_words)
+		stats->max_used_words = used_words;
+}
+
+static void __set_tx_req(struct msm_vidc_iface_q_info *qinfo,
+	struct hfi_queue_header *queue, u32 tx_req)
+{
+	if (queue->qhdr_tx_req != tx_req)
+		qinfo->stats.tx_req_toggles++;
+	queue->qhdr_tx_req = tx_req;
+}
+
+static void __set_rx_req(struct msm_vidc_iface_q_info *qinfo,
+	struct hfi_queue_header *queue, u32 rx_req)
+{
+	if (queue->qhdr_rx_req != rx_req)
+		qinfo->stats.rx_req_toggles++;
+	queue->qhdr_rx_req = rx_req;
+}
+
+/* remember when each command packet was sent, keyed by packet_id */
+static void __latency_mark_sent(struct msm_vidc_core *core, u8 *packet)
+{
+	struct msm_vidc_hfi_latency *lat = &core->hfi_latency;
+	struct hfi_header *hdr = (struct hfi_header *)packet;
+	struct hfi_packet *pkt;
+	ktime_t now = ktime_get();
+	u8 *cur, *end;
+	u32 i, slot;
+
+	cur = packet + sizeof(struct hfi_header);
+	end = packet + hdr->size;
+
+	spin_lock(&lat->lock);
+	for (i = 0; i < hdr->num_packets; i++) {
+		pkt = (struct hfi_packet *)cur;
+		if (cur + sizeof(struct hfi_packet) > end ||
+		    pkt->size < sizeof(struct hfi_packet))
+			break;
+		slot = pkt->packet_id & (HFI_LATENCY_SLOTS - 1);
+		lat->packet_id[slot] = pkt->packet_id;
+		lat->sent[slot] = now;
+		cur += pkt->size;
+	}
+	spin_unlock(&lat->lock);
+}
+
+/* account the first response carrying the packet_id of a sent command */
+static void __latency_mark_done(struct msm_vidc_core *core, u8 *packet)
+{
+	struct msm_vidc_hfi_latency *lat = &core->hfi_latency;
+	struct hfi_header *hdr = (struct hfi_header *)packet;
+	struct hfi_packet *pkt;
+	ktime_t now = ktime_get();
+	u32 i, slot, bucket;
+	u8 *cur, *end;
+	u64 us;
+
+	if (hdr->size < sizeof(struct hfi_header) ||
+	    hdr->size > VIDC_IFACEQ_VAR_HUGE_PKT_SIZE)
+		return;
+
+	cur = packet + sizeof(struct hfi_header);
+	end = packet + hdr->size;
+
+	spin_lock(&lat->lock);
+	for (i = 0; i < hdr->num_packets; i++) {
+		pkt = (struct hfi_packet *)cur;
+		if (cur + sizeof(struct hfi_packet) > end ||
+		    pkt->size < sizeof(struct hfi_packet))
+			break;
+		cur += pkt->size;
+
+		slot = pkt->packet_id & (HFI_LATENCY_SLOTS - 1);
+		if (!lat->sent[slot] || lat->packet_id[slot] != pkt->packet_id)
+			continue;
+
+		us = ktime_us_delta(now, lat->sent[slot]);
+		lat->sent[slot] = 0;
+
+		bucket = us < 16 ? 0 : min_t(u32, ilog2(us) - 3,
+					     HFI_LATENCY_BUCKETS - 1);
+		lat->hist[bucket]++;
+		lat->count++;
+		lat->total_us += us;
+		if (us > lat->max_us)
+			lat->max_us = us;
+	}
+	spin_unlock(&lat->lock);
+}
+
 static int __write_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 			 bool *rx_req_is_set)
 {
@@ -100,13 +213,14 @@ static int __write_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 		((qinfo->q_array.mem_size>>2) - (write_idx -  read_idx)) :
 		(read_idx - write_idx);
 	if (empty_space <= packet_size_in_words) {
-		queue->qhdr_tx_req =  1;
-		d_vpr_e("Insufficient size (%d) to write (%d)\n",
+		__set_tx_req(qinfo, queue, 1);
+		qinfo->stats.full_count++;
+		d_vpr_l("Insufficient size (%d) to write (%d)\n",
 					  empty_space, packet_size_in_words);
 		return -ENOTEMPTY;
 	}
 
-	queue->qhdr_tx_req =  0;
+	__set_tx_req(qinfo, queue, 0);
 
 	new_write_idx = write_idx + packet_size_in_words;
 	write_ptr = (u32 *)((qinfo->q_array.align_virtual_addr) +
@@ -135,6 +249,8 @@ static int __write_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 	 */
 	mb();
 	queue->qhdr_write_idx = new_write_idx;
+	__update_queue_stats(qinfo, packet_size_in_words << 2,
+		__queue_used_words(qinfo, read_idx, new_write_idx));
 	if (rx_req_is_set)
 		*rx_req_is_set = true;
 	/*
@@ -191,7 +307,7 @@ static int __read_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 	write_idx = queue->qhdr_write_idx;
 
 	if (read_idx == write_idx) {
-		queue->qhdr_rx_req = receive_request;
+		__set_rx_req(qinfo, queue, receive_request);
 		/*
 		 * mb() to ensure qhdr is updated in main memory
 		 * so that venus reads the updated header values
@@ -236,6 +352,8 @@ static int __read_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 					(u8 *)qinfo->q_array.align_virtual_addr,
 					new_read_idx << 2);
 		}
+		__update_queue_stats(qinfo, packet_size_in_words << 2,
+			__queue_used_words(qinfo, read_idx, write_idx));
 	} else {
 		d_vpr_e("BAD packet received, read_idx: %#x, pkt_size: %d\n",
 			read_idx, packet_size_in_words << 2);
@@ -244,7 +362,7 @@ static int __read_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 		rc = -ENODATA;
 	}
 
-	queue->qhdr_rx_req = receive_request;
+	__set_rx_req(qinfo, queue, receive_request);
 
 	queue->qhdr_read_idx = new_read_idx;
 	/*
@@ -263,7 +381,83 @@ static int __read_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 	return rc;
 }
 
-/* Writes into cmdq without raising an interrupt */
+static struct msm_vidc_inst *__cmdq_backlog_inst(struct msm_vidc_core *core,
+	u32 session_id)
+{
+	struct msm_vidc_inst *inst;
+
+	if (!session_id)
+		return NULL;
+
+	list_for_each_entry(inst, &core->instances, list) {
+		if (inst->session_id == session_id)
+			return inst;
+	}
+
+	return NULL;
+}
+
+static int __cmdq_backlog_park(struct msm_vidc_core *core, u8 *packet)
+{
+	struct hfi_header *hdr = (struct hfi_header *)packet;
+	struct cmdq_backlog_entry *entry;
+
+	if (core->cmdq_backlog_count >= msm_vidc_cmdq_backlog_max)
+		return -ENOTEMPTY;
+
+	entry = kmalloc(sizeof(*entry) + hdr->size, GFP_KERNEL);
+	if (!entry) {
+		d_vpr_e("%s: allocation failed\n", __func__);
+		return -ENOMEM;
+	}
+	entry->inst = __cmdq_backlog_inst(core, hdr->session_id);
+	if (entry->inst && !entry->inst->cmdq_parked++)
+		core->cmdq_backlog_sessions++;
+	memcpy(entry->packet, packet, hdr->size);
+	list_add_tail(&entry->list, &core->cmdq_backlog);
+	core->cmdq_backlog_count++;
+	core->cmdq_parked++;
+
+	return 0;
+}
+
+static void __cmdq_backlog_del(struct msm_vidc_core *core,
+	struct cmdq_backlog_entry *entry)
+{
+	if (entry->inst && !--entry->inst->cmdq_parked)
+		core->cmdq_backlog_sessions--;
+	list_del(&entry->list);
+	kfree(entry);
+	core->cmdq_backlog_count--;
+}
+
+/* moves parked packets to the cmd queue, oldest first, as space allows */
+static void __cmdq_backlog_flush(struct msm_vidc_core *core,
+	struct msm_vidc_iface_q_info *q_info, bool *requires_interrupt)
+{
+	struct cmdq_backlog_entry *entry, *dummy;
+
+	list_for_each_entry_safe(entry, dummy, &core->cmdq_backlog, list) {
+		if (__write_queue(q_info, entry->packet, requires_interrupt))
+			break;
+		__latency_mark_sent(core, entry->packet);
+		__cmdq_backlog_del(core, entry);
+	}
+}
+
+static void __cmdq_backlog_free(struct msm_vidc_core *core)
+{
+	struct cmdq_backlog_entry *entry, *dummy;
+
+	list_for_each_entry_safe(entry, dummy, &core->cmdq_backlog, list)
+		__cmdq_backlog_del(core, entry);
+}
+
+/*
+ * Writes into cmdq without raising an interrupt. Packets which do not fit
+ * are parked on the host backlog and written out once firmware has made
+ * room, see venus_hfi_queue_cmd_backlog_flush().
+ */
 static int __iface_cmdq_write_relaxed(struct msm_vidc_core *core,
 				      void *pkt, bool *requires_interrupt)
 {
@@ -296,22 +490,59 @@ static int __iface_cmdq_write_relaxed(struct msm_vidc_core *core,
 		goto err_q_null;
 	}
 
-	if (!__write_queue(q_info, (u8 *)pkt, requires_interrupt))
-		rc = 0;
-	else
+	/* keep packet order, parked packets go out first */
+	if (core->cmdq_backlog_count)
+		__cmdq_backlog_flush(core, q_info, requires_interrupt);
+
+	rc = core->cmdq_backlog_count ? -ENOTEMPTY :
+		__write_queue(q_info, (u8 *)pkt, requires_interrupt);
+	if (!rc) {
+		__latency_mark_sent(core, (u8 *)pkt);
+	} else if (rc == -ENOTEMPTY) {
+		rc = __cmdq_backlog_park(core, (u8 *)pkt);
+		/* make sure firmware drains what is already queued */
+		if (!rc && requires_interrupt)
+			*requires_interrupt = true;
+	}
+	if (rc)
 		d_vpr_e("queue full\n");
 
 err_q_null:
 	return rc;
 }
 
+static u32 __cmdq_used_words(struct msm_vidc_core *core)
+{
+	struct msm_vidc_iface_q_info *q_info;
+	struct hfi_queue_header *queue;
+
+	q_info = &core->iface_queues[VIDC_IFACEQ_CMDQ_IDX];
+	queue = (struct hfi_queue_header *)q_info->q_hdr;
+	if (!queue)
+		return 0;
+
+	return __queue_used_words(q_info, queue->qhdr_read_idx,
+		queue->qhdr_write_idx);
+}
+
+static void __raise_interrupt(struct msm_vidc_core *core)
+{
+	/* every packet queued so far is visible to firmware after this */
+	if (core->doorbell_pending) {
+		core->doorbell_pending = 0;
+		hrtimer_try_to_cancel(&core->doorbell_timer);
+	}
+	core->doorbell_raised++;
+	call_venus_op(core, raise_interrupt, core);
+}
+
 int venus_hfi_queue_cmd_write(struct msm_vidc_core *core, void *pkt)
 {
 	bool needs_interrupt = false;
 	int rc = __iface_cmdq_write_relaxed(core, pkt, &needs_interrupt);
 
 	if (!rc && needs_interrupt)
-		call_venus_op(core, raise_interrupt, core);
+		__raise_interrupt(core);
 
 	return rc;
 }
@@ -322,50 +553,292 @@ int venus_hfi_queue_cmd_write_intr(struct msm_vidc_core *core, void *pkt,
 	bool needs_interrupt = false;
 	int rc = __iface_cmdq_write_relaxed(core, pkt, &needs_interrupt);
 
-	if (!rc && allow_intr && needs_interrupt)
-		call_venus_op(core, raise_interrupt, core);
+	if (!rc && needs_interrupt) {
+		if (allow_intr)
+			__raise_interrupt(core);
+		else
+			core->doorbell_pending++;
+	}
 
 	return rc;
 }
 
-int venus_hfi_queue_msg_read(struct msm_vidc_core *core, void *pkt)
+/*
+ * Writes into cmdq and defers the interrupt so that a burst of buffer
+ * packets, possibly from different sessions, is announced to firmware
+ * with a single doorbell. The doorbell is raised once the burst reaches
+ * msm_vidc_doorbell_batch packets, once the cmdq is half full, or when
+ * doorbell_timer expires after msm_vidc_doorbell_delay_us.
+ */
+int venus_hfi_queue_cmd_write_deferred(struct msm_vidc_core *core, void *pkt)
+{
+	bool needs_interrupt = false;
+	u32 q_size;
+	int rc;
+
+	if (msm_vidc_doorbell_batch <= 1 || !msm_vidc_doorbell_delay_us)
+		return venus_hfi_queue_cmd_write(core, pkt);
+
+	rc = __iface_cmdq_write_relaxed(core, pkt, &needs_interrupt);
+	if (rc || !needs_interrupt)
+		return rc;
+
+	core->doorbell_pending++;
+	core->doorbell_deferred++;
+
+	q_size = core->iface_queues[VIDC_IFACEQ_CMDQ_IDX].q_array.mem_size >> 2;
+	if (core->doorbell_pending >= msm_vidc_doorbell_batch ||
+	    __cmdq_used_words(core) >= (q_size >> 1)) {
+		__raise_interrupt(core);
+	} else if (!hrtimer_active(&core->doorbell_timer)) {
+		hrtimer_start(&core->doorbell_timer,
+			      us_to_ktime(msm_vidc_doorbell_delay_us),
+			      HRTIMER_MODE_REL);
+	}
+
+	return rc;
+}
+
+void venus_hfi_queue_flush_doorbell(struct msm_vidc_core *core)
+{
+	if (__strict_check(core, __func__))
+		return;
+
+	if (!core->doorbell_pending)
+		return;
+
+	/* __power_collapse() flushes pending doorbells before power off */
+	if (!core_in_valid_state(core) ||
+	    !is_core_sub_state(core, CORE_SUBSTATE_POWER_ENABLE)) {
+		core->doorbell_pending = 0;
+		return;
+	}
+
+	d_vpr_l("%s: flushing %u deferred packets\n",
+		__func__, core->doorbell_pending);
+	__raise_interrupt(core);
+}
+
+/*
+ * Called once firmware has consumed commands, i.e. after the msg queue
+ * was drained, to write out packets parked while the cmd queue was full.
+ */
+void venus_hfi_queue_cmd_backlog_flush(struct msm_vidc_core *core)
+{
+	bool needs_interrupt = false;
+
+	if (__strict_check(core, __func__))
+		return;
+
+	if (!core->cmdq_backlog_count)
+		return;
+
+	if (!core_in_valid_state(core)) {
+		__cmdq_backlog_free(core);
+		return;
+	}
+
+	__cmdq_backlog_flush(core, &core->iface_queues[VIDC_IFACEQ_CMDQ_IDX],
+		&needs_interrupt);
+	if (needs_interrupt)
+		__raise_interrupt(core);
+}
+
+/*
+ * Returns true once a session holds its share of the cmd queue backlog,
+ * the backlog being shared evenly among the sessions parking packets.
+ * Callers hold the core lock.
+ */
+bool venus_hfi_queue_cmd_backlogged(struct msm_vidc_core *core,
+	struct msm_vidc_inst *inst)
+{
+	u32 share;
+
+	if (!core->cmdq_backlog_count)
+		return false;
+
+	if (core->cmdq_backlog_count >= msm_vidc_cmdq_backlog_max)
+		return true;
+
+	if (!inst->cmdq_parked)
+		return false;
+
+	share = max_t(u32, msm_vidc_cmdq_backlog_max /
+		max_t(u32, core->cmdq_backlog_sessions, 1), 1);
+
+	return inst->cmdq_parked >= share;
+}
+
+/*
+ * Drops the packets a session still has parked once it is removed,
+ * firmware no longer knows the session. Callers hold the core lock.
+ */
+void venus_hfi_queue_cmd_backlog_drop(struct msm_vidc_core *core,
+	struct msm_vidc_inst *inst)
+{
+	struct cmdq_backlog_entry *entry, *dummy;
+
+	if (!inst->cmdq_parked)
+		return;
+
+	list_for_each_entry_safe(entry, dummy, &core->cmdq_backlog, list) {
+		if (entry->inst == inst)
+			__cmdq_backlog_del(core, entry);
+	}
+}
+
+static struct hfi_queue_header *__get_msgq(struct msm_vidc_core *core,
+	const char *func)
 {
-	u32 tx_req_is_set = 0;
-	int rc = 0;
 	struct msm_vidc_iface_q_info *q_info;
 
-	if (!pkt) {
+	if (!core_in_valid_state(core)) {
+		d_vpr_e("%s: fw not in init state\n", func);
+		return NULL;
+	}
+
+	q_info = &core->iface_queues[VIDC_IFACEQ_MSGQ_IDX];
+	if (!q_info->q_array.align_virtual_addr || !q_info->q_hdr) {
+		d_vpr_e("%s: cannot read from shared MSG Q's\n", func);
+		return NULL;
+	}
+
+	return (struct hfi_queue_header *)q_info->q_hdr;
+}
+
+int venus_hfi_queue_msg_begin(struct msm_vidc_core *core, u32 *read_idx)
+{
+	struct hfi_queue_header *queue;
+
+	if (!read_idx) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
 
-	if (!core_in_valid_state(core)) {
-		d_vpr_e("%s: fw not in init state\n", __func__);
-		rc = -EINVAL;
-		goto read_error_null;
+	queue = __get_msgq(core, __func__);
+	if (!queue)
+		return -EINVAL;
+
+	*read_idx = queue->qhdr_read_idx;
+	return 0;
+}
+
+/*
+ * Peek the message at *read_idx without consuming it. *pkt points straight
+ * into the shared msgq ring, unless the message wraps around the end of
+ * the ring, in which case it is copied into @buf. The ring read index is
+ * left untouched until venus_hfi_queue_msg_commit(), so firmware cannot
+ * reuse the ring space of messages still being parsed. The size word is
+ * fetched once and returned in *pkt_size, callers must bound parsing by it
+ * rather than re-read it from the ring.
+ */
+int venus_hfi_queue_msg_peek(struct msm_vidc_core *core, u32 *read_idx,
+	u8 *buf, u8 **pkt, u32 *pkt_size)
+{
+	struct msm_vidc_iface_q_info *q_info;
+	struct hfi_queue_header *queue;
+	u32 packet_size_in_words, new_read_idx, q_size, write_idx;
+	u32 *read_ptr;
+
+	if (!read_idx || !buf || !pkt || !pkt_size) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
 	}
 
+	queue = __get_msgq(core, __func__);
+	if (!queue)
+		return -EINVAL;
+
 	q_info = &core->iface_queues[VIDC_IFACEQ_MSGQ_IDX];
-	if (!q_info->q_array.align_virtual_addr) {
-		d_vpr_e("cannot read from shared MSG Q's\n");
-		rc = -ENODATA;
-		goto read_error_null;
+	q_size = q_info->q_array.mem_size >> 2;
+
+	/*
+	 * Memory barrier to make sure data is valid before
+	 * reading it
+	 */
+	mb();
+	write_idx = queue->qhdr_write_idx;
+	if (*read_idx == write_idx)
+		return -ENODATA;
+
+	read_ptr = (u32 *)((q_info->q_array.align_virtual_addr) +
+				(*read_idx << 2));
+	if (*read_idx >= q_size) {
+		d_vpr_e("Invalid read index\n");
+		*read_idx = write_idx;
+		return -ENODATA;
 	}
 
-	if (!__read_queue(q_info, (u8 *)pkt, &tx_req_is_set)) {
-		if (tx_req_is_set) {
-			//call_venus_op(core, raise_interrupt, core);
-			d_vpr_e("%s: queue is full\n", __func__);
-			rc = -EINVAL;
-			goto read_error_null;
-		}
-		rc = 0;
+	packet_size_in_words = READ_ONCE(*read_ptr) >> 2;
+	if (!packet_size_in_words ||
+	    (packet_size_in_words << 2) > VIDC_IFACEQ_VAR_HUGE_PKT_SIZE) {
+		d_vpr_e("BAD packet received, read_idx: %#x, pkt_size: %d\n",
+			*read_idx, packet_size_in_words << 2);
+		d_vpr_e("Dropping this packet\n");
+		*read_idx = write_idx;
+		return -ENODATA;
+	}
+
+	new_read_idx = *read_idx + packet_size_in_words;
+	if (new_read_idx < q_size) {
+		*pkt = (u8 *)read_ptr;
 	} else {
-		rc = -ENODATA;
+		new_read_idx -= q_size;
+		memcpy(buf, read_ptr,
+			(packet_size_in_words - new_read_idx) << 2);
+		memcpy(buf + ((packet_size_in_words - new_read_idx) << 2),
+			(u8 *)q_info->q_array.align_virtual_addr,
+			new_read_idx << 2);
+		*pkt = buf;
 	}
+	__update_queue_stats(q_info, packet_size_in_words << 2,
+		__queue_used_words(q_info, *read_idx, write_idx));
+	*read_idx = new_read_idx;
+	*pkt_size = packet_size_in_words << 2;
 
-read_error_null:
-	return rc;
+	__latency_mark_done(core, *pkt);
+
+	if (msm_vidc_debug & VIDC_PKT)
+		__dump_packet(*pkt, __func__, q_info);
+
+	return 0;
+}
+
+/*
+ * Release the ring space of all messages peeked since @start_idx and set
+ * whether firmware should interrupt on new messages. The update is
+ * dropped if the queue was reset in the meantime, e.g. due to a core
+ * deinit triggered while handling one of the messages.
+ */
+void venus_hfi_queue_msg_commit(struct msm_vidc_core *core, u32 start_idx,
+	u32 read_idx, bool rx_req)
+{
+	struct msm_vidc_iface_q_info *q_info;
+	struct hfi_queue_header *queue;
+
+	queue = __get_msgq(core, __func__);
+	if (!queue)
+		return;
+	q_info = &core->iface_queues[VIDC_IFACEQ_MSGQ_IDX];
+
+	if (queue->qhdr_read_idx != start_idx) {
+		d_vpr_e("%s: msg queue reset, read_idx %u expected %u\n",
+			__func__, queue->qhdr_read_idx, start_idx);
+		return;
+	}
+
+	__set_rx_req(q_info, queue, rx_req ? 1 : 0);
+	queue->qhdr_read_idx = read_idx;
+	/*
+	 * mb() to ensure qhdr is updated in main memory
+	 * so that venus reads the updated header values
+	 */
+	mb();
+
+	if (queue->qhdr_tx_req == 1) {
+		q_info->stats.full_count++;
+		d_vpr_e("%s: queue is full\n", __func__);
+	}
 }
 
 int venus_hfi_queue_dbg_read(struct msm_vidc_core *core, void *pkt)
@@ -388,6 +861,7 @@ int venus_hfi_queue_dbg_read(struct msm_vidc_core *core, void *pkt)
 
 	if (!__read_queue(q_info, (u8 *)pkt, &tx_req_is_set)) {
 		if (tx_req_is_set) {
+			q_info->stats.full_count++;
 			d_vpr_e("%s: queue is full\n", __func__);
 			//call_venus_op(core, raise_interrupt, core);
 			rc = -EINVAL;
@@ -413,6 +887,9 @@ void venus_hfi_queue_deinit(struct msm_vidc_core *core)
 		return;
 	}
 
+	core->doorbell_pending = 0;
+	__cmdq_backlog_free(core);
+
 	call_mem_op(core, memory_unmap_free, core, &core->iface_q_table.mem);
 	call_mem_op(core, memory_unmap_free, core, &core->sfr.mem);
 #if 0
@@ -459,6 +936,8 @@ int venus_hfi_reset_queue_header(struct msm_vidc_core *core)
 		iface_q = &core->iface_queues[i];
 		__set_queue_hdr_defaults(iface_q->q_hdr);
 	}
+	core->doorbell_pending = 0;
+	__cmdq_backlog_free(core);
 
 	iface_q = &core->iface_queues[VIDC_IFACEQ_CMDQ_IDX];
 	q_hdr = iface_q->q_hdr;
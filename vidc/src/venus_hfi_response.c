@@ -205,28 +205,47 @@ int validate_packet(u8 *response_pkt, u8 *core_resp_pkt,
 	return 0;
 }
 
+/*
+ * Messages are parsed in place in the msgq ring, which firmware can write
+ * to. Header bounds are fetched once by handle_response() and each packet
+ * size is fetched once per step and checked against them.
+ */
+static u8 *next_hfi_packet(u8 *pkt, u8 *end)
+{
+	u32 size = READ_ONCE(((struct hfi_packet *)pkt)->size);
+
+	if (size < sizeof(struct hfi_packet) || size > end - pkt)
+		return NULL;
+
+	return pkt + size;
+}
+
 static int validate_hdr_packet(struct msm_vidc_core *core,
-	struct hfi_header *hdr, const char *function)
+	struct hfi_header *hdr, u32 size, u32 num_packets, const char *function)
 {
-	struct hfi_packet *packet;
-	u8 *pkt;
+	u8 *pkt, *end;
 	int i, rc = 0;
 
-	if (hdr->size < sizeof(struct hfi_header) + sizeof(struct hfi_packet)) {
-		d_vpr_e("%s: invalid header size %d\n", __func__, hdr->size);
+	if (size < sizeof(struct hfi_header) + sizeof(struct hfi_packet)) {
+		d_vpr_e("%s: invalid header size %d\n", __func__, size);
 		return -EINVAL;
 	}
 
 	pkt = (u8 *)((u8 *)hdr + sizeof(struct hfi_header));
+	end = (u8 *)hdr + size;
 
 	/* validate all packets */
-	for (i = 0; i < hdr->num_packets; i++) {
-		packet = (struct hfi_packet *)pkt;
-		rc = validate_packet(pkt, core->response_packet, core->packet_size, function);
+	for (i = 0; i < num_packets; i++) {
+		rc = validate_packet(pkt, (u8 *)hdr, size, function);
 		if (rc)
 			return rc;
 
-		pkt += packet->size;
+		pkt = next_hfi_packet(pkt, end);
+		if (!pkt) {
+			d_vpr_e("%s: packet %d of %u changed size\n",
+				function, i, num_packets);
+			return -EINVAL;
+		}
 	}
 
 	return 0;
@@ -445,7 +464,6 @@ static int handle_session_close(struct msm_vidc_inst *inst,
 	if (pkt->flags & HFI_FW_FLAGS_SUCCESS)
 		i_vpr_h(inst, "%s: successful\n", __func__);
 
-	signal_session_msg_receipt(inst, SIGNAL_CMD_CLOSE);
 	return 0;
 }
 
@@ -462,7 +480,7 @@ static int handle_session_stop(struct msm_vidc_inst *inst,
 	struct hfi_packet *pkt)
 {
 	int rc = 0;
-	enum signal_session_response signal_type = -1;
+	enum msm_vidc_port_type port;
 
 	if (pkt->flags & HFI_FW_FLAGS_SUCCESS)
 		i_vpr_h(inst, "%s: successful for port %d\n",
@@ -470,9 +488,9 @@ static int handle_session_stop(struct msm_vidc_inst *inst,
 
 	if (is_encode_session(inst)) {
 		if (pkt->port == HFI_PORT_RAW) {
-			signal_type = SIGNAL_CMD_STOP_INPUT;
+			port = INPUT_PORT;
 		} else if (pkt->port == HFI_PORT_BITSTREAM) {
-			signal_type = SIGNAL_CMD_STOP_OUTPUT;
+			port = OUTPUT_PORT;
 		} else {
 			i_vpr_e(inst, "%s: invalid port: %d\n",
 				__func__, pkt->port);
@@ -480,9 +498,9 @@ static int handle_session_stop(struct msm_vidc_inst *inst,
 		}
 	} else if (is_decode_session(inst)) {
 		if (pkt->port == HFI_PORT_RAW) {
-			signal_type = SIGNAL_CMD_STOP_OUTPUT;
+			port = OUTPUT_PORT;
 		} else if (pkt->port == HFI_PORT_BITSTREAM) {
-			signal_type = SIGNAL_CMD_STOP_INPUT;
+			port = INPUT_PORT;
 		} else {
 			i_vpr_e(inst, "%s: invalid port: %d\n",
 				__func__, pkt->port);
@@ -493,11 +511,9 @@ static int handle_session_stop(struct msm_vidc_inst *inst,
 		return -EINVAL;
 	}
 
-	if (signal_type != -1) {
-		rc = msm_vidc_process_stop_done(inst, signal_type);
-		if (rc)
-			return rc;
-	}
+	rc = msm_vidc_process_stop_done(inst, port);
+	if (rc)
+		return rc;
 
 	return 0;
 }
@@ -567,6 +583,21 @@ static int get_driver_buffer_flags(struct msm_vidc_inst *inst, u32 hfi_flags)
 	return driver_flags;
 }
 
+static bool msm_vidc_dpb_set_find(struct msm_vidc_inst *inst,
+	u64 device_addr, u32 data_offset, bool match_offset)
+{
+	struct msm_vidc_dpb_entry *entry;
+
+	hash_for_each_possible(inst->dpb_set.hash, entry, hnode, device_addr) {
+		if (entry->device_addr != device_addr)
+			continue;
+		if (!match_offset || entry->data_offset == data_offset)
+			return true;
+	}
+
+	return false;
+}
+
 static int handle_read_only_buffer(struct msm_vidc_inst *inst,
 				   struct msm_vidc_buffer *buf)
 {
@@ -610,13 +641,15 @@ static int handle_read_only_buffer(struct msm_vidc_inst *inst,
 		ro_buf->data_offset = buf->data_offset;
 		ro_buf->dbuf_get = buf->dbuf_get;
 		buf->dbuf_get = 0;
+		ro_buf->dpb_ref = msm_vidc_dpb_set_find(inst, ro_buf->device_addr,
+							ro_buf->data_offset, true);
 		INIT_LIST_HEAD(&ro_buf->list);
 		list_add_tail(&ro_buf->list, &inst->buffers.read_only.list);
 		print_vidc_buffer(VIDC_LOW, "low ", "ro buf added", inst, ro_buf);
 	} else {
 		print_vidc_buffer(VIDC_LOW, "low ", "ro buf found", inst, ro_buf);
 	}
-	ro_buf->attr |= MSM_VIDC_ATTR_READ_ONLY;
+	msm_vidc_update_buffer_attr(inst, ro_buf, MSM_VIDC_ATTR_READ_ONLY, 0);
 
 	return 0;
 }
@@ -634,7 +667,7 @@ static int handle_non_read_only_buffer(struct msm_vidc_inst *inst,
 
 	list_for_each_entry(ro_buf, &inst->buffers.read_only.list, list) {
 		if (ro_buf->device_addr == buffer->base_address) {
-			ro_buf->attr &= ~MSM_VIDC_ATTR_READ_ONLY;
+			msm_vidc_update_buffer_attr(inst, ro_buf, 0, MSM_VIDC_ATTR_READ_ONLY);
 			break;
 		}
 	}
@@ -686,21 +719,14 @@ static int handle_input_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf;
 	struct msm_vidc_core *core;
 	u32 frame_size, batch_size;
-	bool found;
 
 	core = inst->core;
 	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_INPUT, __func__);
 	if (!buffers)
 		return -EINVAL;
 
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (buf->index == buffer->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	buf = msm_vidc_buffer_by_index(buffers, buffer->index);
+	if (!buf) {
 		i_vpr_e(inst, "%s: invalid buffer idx %d addr %#llx data_offset %d\n",
 			__func__, buffer->index, buffer->base_address,
 			buffer->data_offset);
@@ -744,8 +770,7 @@ static int handle_input_buffer(struct msm_vidc_inst *inst,
 	}
 
 	buf->data_size = buffer->data_size;
-	buf->attr &= ~MSM_VIDC_ATTR_QUEUED;
-	buf->attr |= MSM_VIDC_ATTR_DEQUEUED;
+	msm_vidc_update_buffer_attr(inst, buf, MSM_VIDC_ATTR_DEQUEUED, MSM_VIDC_ATTR_QUEUED);
 
 	buf->flags = 0;
 	buf->flags = get_driver_buffer_flags(inst, buffer->flags);
@@ -875,20 +900,11 @@ static int handle_output_buffer(struct msm_vidc_inst *inst,
 	if (!buffers)
 		return -EINVAL;
 
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (!(buf->attr & MSM_VIDC_ATTR_QUEUED))
-			continue;
-		if (is_decode_session(inst))
-			found = (buf->index == buffer->index &&
-				buf->device_addr == buffer->base_address &&
-				buf->data_offset == buffer->data_offset);
-		else
-			found = (buf->index == buffer->index);
-
-		if (found)
-			break;
-	}
+	buf = msm_vidc_buffer_by_index(buffers, buffer->index);
+	found = buf && (buf->attr & MSM_VIDC_ATTR_QUEUED);
+	if (found && is_decode_session(inst))
+		found = (buf->device_addr == buffer->base_address &&
+			buf->data_offset == buffer->data_offset);
 	if (!found) {
 		i_vpr_l(inst, "%s: invalid idx %d daddr %#llx\n",
 			__func__, buffer->index, buffer->base_address);
@@ -899,8 +915,7 @@ static int handle_output_buffer(struct msm_vidc_inst *inst,
 	buf->data_size = buffer->data_size;
 	buf->timestamp = buffer->timestamp;
 
-	buf->attr &= ~MSM_VIDC_ATTR_QUEUED;
-	buf->attr |= MSM_VIDC_ATTR_DEQUEUED;
+	msm_vidc_update_buffer_attr(inst, buf, MSM_VIDC_ATTR_DEQUEUED, MSM_VIDC_ATTR_QUEUED);
 
 	if (is_encode_session(inst)) {
 		/* encoder output is not expected to be corrupted */
@@ -953,12 +968,12 @@ static int handle_output_buffer(struct msm_vidc_inst *inst,
 		}
 
 		if (buffer->flags & HFI_BUF_FW_FLAG_READONLY) {
-			buf->attr |= MSM_VIDC_ATTR_READ_ONLY;
+			msm_vidc_update_buffer_attr(inst, buf, MSM_VIDC_ATTR_READ_ONLY, 0);
 			rc = handle_read_only_buffer(inst, buf);
 			if (rc)
 				msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
 		} else {
-			buf->attr &= ~MSM_VIDC_ATTR_READ_ONLY;
+			msm_vidc_update_buffer_attr(inst, buf, 0, MSM_VIDC_ATTR_READ_ONLY);
 		}
 
 		if (buf->dbuf_get) {
@@ -1005,21 +1020,14 @@ static int handle_input_metadata_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf;
 	struct msm_vidc_core *core;
 	u32 frame_size, batch_size;
-	bool found;
 
 	core = inst->core;
 	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_INPUT_META, __func__);
 	if (!buffers)
 		return -EINVAL;
 
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (buf->index == buffer->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	buf = msm_vidc_buffer_by_index(buffers, buffer->index);
+	if (!buf) {
 		i_vpr_e(inst, "%s: invalid idx %d daddr %#llx data_offset %d\n",
 			__func__, buffer->index, buffer->base_address,
 			buffer->data_offset);
@@ -1047,8 +1055,7 @@ static int handle_input_metadata_buffer(struct msm_vidc_inst *inst,
 	}
 
 	buf->data_size = buffer->data_size;
-	buf->attr &= ~MSM_VIDC_ATTR_QUEUED;
-	buf->attr |= MSM_VIDC_ATTR_DEQUEUED;
+	msm_vidc_update_buffer_attr(inst, buf, MSM_VIDC_ATTR_DEQUEUED, MSM_VIDC_ATTR_QUEUED);
 	buf->flags = 0;
 	if (buffer->flags & HFI_BUF_FW_FLAG_LAST ||
 	    buffer->flags & HFI_BUF_FW_FLAG_PSC_LAST)
@@ -1071,20 +1078,13 @@ static int handle_output_metadata_buffer(struct msm_vidc_inst *inst,
 	int rc = 0;
 	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf;
-	bool found;
 
 	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_OUTPUT_META, __func__);
 	if (!buffers)
 		return -EINVAL;
 
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (buf->index == buffer->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	buf = msm_vidc_buffer_by_index(buffers, buffer->index);
+	if (!buf) {
 		i_vpr_e(inst, "%s: invalid idx %d daddr %#llx data_offset %d\n",
 			__func__, buffer->index, buffer->base_address,
 			buffer->data_offset);
@@ -1097,8 +1097,7 @@ static int handle_output_metadata_buffer(struct msm_vidc_inst *inst,
 	}
 
 	buf->data_size = buffer->data_size;
-	buf->attr &= ~MSM_VIDC_ATTR_QUEUED;
-	buf->attr |= MSM_VIDC_ATTR_DEQUEUED;
+	msm_vidc_update_buffer_attr(inst, buf, MSM_VIDC_ATTR_DEQUEUED, MSM_VIDC_ATTR_QUEUED);
 	buf->flags = 0;
 	if (buffer->flags & HFI_BUF_FW_FLAG_LAST ||
 	    buffer->flags & HFI_BUF_FW_FLAG_PSC_LAST)
@@ -1134,20 +1133,17 @@ static bool is_metabuffer_dequeued(struct msm_vidc_inst *inst,
 	if (!buffers)
 		return false;
 
-	list_for_each_entry(buffer, &buffers->list, list) {
-		if (buffer->index == buf->index &&
-			(buffer->attr & MSM_VIDC_ATTR_DEQUEUED ||
-			buffer->attr & MSM_VIDC_ATTR_BUFFER_DONE)) {
-			/*
-			 * For META_OUTBUF_FENCE case, meta buffers are
-			 * dequeued ahead in time and completed vb2 done
-			 * as well. Hence, check for vb2 buffer done flag since
-			 * dequeued flag is already cleared for such buffers
-			 */
-			found = true;
-			break;
-		}
-	}
+	/*
+	 * For META_OUTBUF_FENCE case, meta buffers are
+	 * dequeued ahead in time and completed vb2 done
+	 * as well. Hence, check for vb2 buffer done flag since
+	 * dequeued flag is already cleared for such buffers
+	 */
+	buffer = msm_vidc_buffer_by_index(buffers, buf->index);
+	if (buffer && (buffer->attr & MSM_VIDC_ATTR_DEQUEUED ||
+		buffer->attr & MSM_VIDC_ATTR_BUFFER_DONE))
+		found = true;
+
 	return found;
 }
 
@@ -1206,7 +1202,7 @@ static int handle_dequeue_buffers(struct msm_vidc_inst *inst)
 
 		list_for_each_entry_safe(buf, dummy, &buffers->list, list) {
 			if (buf->attr & MSM_VIDC_ATTR_DEQUEUED) {
-				buf->attr &= ~MSM_VIDC_ATTR_DEQUEUED;
+				msm_vidc_update_buffer_attr(inst, buf, 0, MSM_VIDC_ATTR_DEQUEUED);
 				/*
 				 * do not send vb2_buffer_done when fw returns
 				 * same buffer again
@@ -1215,7 +1211,8 @@ static int handle_dequeue_buffers(struct msm_vidc_inst *inst)
 					print_vidc_buffer(VIDC_HIGH, "high",
 						"vb2 done already", inst, buf);
 				} else {
-					buf->attr |= MSM_VIDC_ATTR_BUFFER_DONE;
+					msm_vidc_update_buffer_attr(inst, buf,
+						MSM_VIDC_ATTR_BUFFER_DONE, 0);
 
 					rc = msm_vidc_dqbuf_cache_operation(inst, buf);
 					if (rc)
@@ -1268,7 +1265,7 @@ static int handle_release_internal_buffer(struct msm_vidc_inst *inst,
 		return 0;
 
 	/* remove QUEUED attribute */
-	buf->attr &= ~MSM_VIDC_ATTR_QUEUED;
+	msm_vidc_update_buffer_attr(inst, buf, 0, MSM_VIDC_ATTR_QUEUED);
 
 	/*
 	 * firmware will return/release internal buffer in two cases
@@ -1304,8 +1301,8 @@ int handle_release_output_buffer(struct msm_vidc_inst *inst,
 		return -EINVAL;
 	}
 
-	buf->attr &= ~MSM_VIDC_ATTR_READ_ONLY;
-	buf->attr &= ~MSM_VIDC_ATTR_PENDING_RELEASE;
+	msm_vidc_update_buffer_attr(inst, buf, 0,
+		MSM_VIDC_ATTR_READ_ONLY | MSM_VIDC_ATTR_PENDING_RELEASE);
 	print_vidc_buffer(VIDC_LOW, "low ", "release done", inst, buf);
 
 	return rc;
@@ -1536,6 +1533,11 @@ static int handle_session_command(struct msm_vidc_inst *inst,
 		{HFI_CMD_STABILITY,         handle_session_stability          },
 	};
 
+	/* waiters are woken once inst lock is released, after handling */
+	if (pkt->type != HFI_CMD_BUFFER)
+		msm_vidc_session_cmd_done(inst, pkt->type, pkt->port,
+					  pkt->packet_id);
+
 	/* handle session pkt */
 	for (i = 0; i < ARRAY_SIZE(hfi_pkt_handle); i++) {
 		if (hfi_pkt_handle[i].type == pkt->type) {
@@ -1562,8 +1564,8 @@ static int handle_dpb_list_property(struct msm_vidc_inst *inst,
 	u8 *payload_start;
 	int i = 0;
 	struct msm_vidc_buffer *ro_buf;
-	bool found = false;
-	u64 device_addr;
+	struct msm_vidc_dpb_set *set = &inst->dpb_set;
+	struct msm_vidc_dpb_entry *entry;
 
 	if (!is_decode_session(inst)) {
 		i_vpr_e(inst,
@@ -1591,15 +1593,22 @@ static int handle_dpb_list_property(struct msm_vidc_inst *inst,
 	 * payload[2]             : 32 bits addr_offset  of DPB-1
 	 * payload[3]             : 32 bits data_offset  of DPB-1
 	 */
+	hash_init(set->hash);
+	set->count = 0;
 	for (i = 0; (i + 3) < num_words_in_payload; i = i + 4) {
 		i_vpr_l(inst,
 			"%s: base addr %#x %#x, addr offset %#x, data offset %#x\n",
 			__func__, inst->dpb_list_payload[i], inst->dpb_list_payload[i + 1],
 			inst->dpb_list_payload[i + 2], inst->dpb_list_payload[i + 3]);
+		entry = &set->entries[set->count++];
+		entry->device_addr = *((u64 *)(&inst->dpb_list_payload[i]));
+		entry->data_offset = inst->dpb_list_payload[i + 3];
+		hash_add(set->hash, &entry->hnode, entry->device_addr);
 	}
 
 	list_for_each_entry(ro_buf, &inst->buffers.read_only.list, list) {
-		found = false;
+		ro_buf->dpb_ref = msm_vidc_dpb_set_find(inst, ro_buf->device_addr,
+							ro_buf->data_offset, true);
 		/* do not mark RELEASE_ELIGIBLE for non-read only buffers */
 		if (!(ro_buf->attr & MSM_VIDC_ATTR_READ_ONLY))
 			continue;
@@ -1612,16 +1621,10 @@ static int handle_dpb_list_property(struct msm_vidc_inst *inst,
 		 */
 		if (ro_buf->attr & MSM_VIDC_ATTR_PENDING_RELEASE)
 			continue;
-		for (i = 0; (i + 3) < num_words_in_payload; i = i + 4) {
-			device_addr = *((u64 *)(&inst->dpb_list_payload[i]));
-			if (ro_buf->device_addr == device_addr) {
-				found = true;
-				break;
-			}
-		}
 		/* mark a buffer as RELEASE_ELIGIBLE if not found in dpb list */
-		if (!found)
-			ro_buf->attr |= MSM_VIDC_ATTR_RELEASE_ELIGIBLE;
+		if (!msm_vidc_dpb_set_find(inst, ro_buf->device_addr, 0, false))
+			msm_vidc_update_buffer_attr(inst, ro_buf,
+				MSM_VIDC_ATTR_RELEASE_ELIGIBLE, 0);
 	}
 
 	return 0;
@@ -1878,11 +1881,11 @@ static int handle_system_property(struct msm_vidc_core *core,
 }
 
 static int handle_system_response(struct msm_vidc_core *core,
-				  struct hfi_header *hdr)
+				  struct hfi_header *hdr, u32 size, u32 num_packets)
 {
 	int rc = 0;
 	struct hfi_packet *packet;
-	u8 *pkt, *start_pkt;
+	u8 *pkt, *start_pkt, *end;
 	int i, j;
 	static const struct msm_vidc_core_hfi_range be[] = {
 		{HFI_SYSTEM_ERROR_BEGIN,   HFI_SYSTEM_ERROR_END,   handle_system_error     },
@@ -1891,9 +1894,10 @@ static int handle_system_response(struct msm_vidc_core *core,
 	};
 
 	start_pkt = (u8 *)((u8 *)hdr + sizeof(struct hfi_header));
+	end = (u8 *)hdr + size;
 	for (i = 0; i < ARRAY_SIZE(be); i++) {
 		pkt = start_pkt;
-		for (j = 0; j < hdr->num_packets; j++) {
+		for (j = 0; j < num_packets && pkt; j++) {
 			packet = (struct hfi_packet *)pkt;
 			/* handle system error */
 			if (packet->flags & HFI_FW_FLAGS_SYSTEM_ERROR) {
@@ -1915,7 +1919,7 @@ static int handle_system_response(struct msm_vidc_core *core,
 					goto exit;
 				}
 			}
-			pkt += packet->size;
+			pkt = next_hfi_packet(pkt, end);
 		}
 	}
 
@@ -1924,11 +1928,11 @@ exit:
 }
 
 static int __handle_session_response(struct msm_vidc_inst *inst,
-				     struct hfi_header *hdr)
+				     struct hfi_header *hdr, u32 size, u32 num_packets)
 {
 	int rc = 0;
 	struct hfi_packet *packet;
-	u8 *pkt, *start_pkt;
+	u8 *pkt, *start_pkt, *end;
 	bool dequeue = false;
 	int i, j;
 	static const struct msm_vidc_inst_hfi_range be[] = {
@@ -1940,9 +1944,10 @@ static int __handle_session_response(struct msm_vidc_inst *inst,
 
 	memset(&inst->hfi_frame_info, 0, sizeof(struct msm_vidc_hfi_frame_info));
 	start_pkt = (u8 *)((u8 *)hdr + sizeof(struct hfi_header));
+	end = (u8 *)hdr + size;
 	for (i = 0; i < ARRAY_SIZE(be); i++) {
 		pkt = start_pkt;
-		for (j = 0; j < hdr->num_packets; j++) {
+		for (j = 0; j < num_packets && pkt; j++) {
 			packet = (struct hfi_packet *)pkt;
 			/* handle session error */
 			if (packet->flags & HFI_FW_FLAGS_SESSION_ERROR) {
@@ -1956,7 +1961,7 @@ static int __handle_session_response(struct msm_vidc_inst *inst,
 				if (rc)
 					msm_vidc_change_state(inst, MSM_VIDC_ERROR, __func__);
 			}
-			pkt += packet->size;
+			pkt = next_hfi_packet(pkt, end);
 		}
 	}
 
@@ -1971,15 +1976,16 @@ static int __handle_session_response(struct msm_vidc_inst *inst,
 }
 
 static int handle_session_response(struct msm_vidc_core *core,
-				   struct hfi_header *hdr)
+				   struct hfi_header *hdr, u32 session_id,
+				   u32 size, u32 num_packets)
 {
 	struct msm_vidc_inst *inst;
 	struct hfi_packet *packet;
-	u8 *pkt;
+	u8 *pkt, *end;
 	int i, rc = 0;
 	bool found_ipsc = false;
 
-	inst = get_inst(core, hdr->session_id);
+	inst = get_inst(core, session_id);
 	if (!inst) {
 		d_vpr_e("%s: Invalid inst\n", __func__);
 		return -EINVAL;
@@ -1988,7 +1994,8 @@ static int handle_session_response(struct msm_vidc_core *core,
 	inst_lock(inst, __func__);
 	/* search for cmd settings change pkt */
 	pkt = (u8 *)((u8 *)hdr + sizeof(struct hfi_header));
-	for (i = 0; i < hdr->num_packets; i++) {
+	end = (u8 *)hdr + size;
+	for (i = 0; i < num_packets && pkt; i++) {
 		packet = (struct hfi_packet *)pkt;
 		if (packet->type == HFI_CMD_SETTINGS_CHANGE) {
 			if (packet->port == HFI_PORT_BITSTREAM) {
@@ -1996,14 +2003,19 @@ static int handle_session_response(struct msm_vidc_core *core,
 				break;
 			}
 		}
-		pkt += packet->size;
+		pkt = next_hfi_packet(pkt, end);
 	}
 
 	/* if ipsc packet is found, initialise subsc_params */
 	if (found_ipsc)
 		msm_vdec_init_input_subcr_params(inst);
 
-	rc = __handle_session_response(inst, hdr);
+	rc = __handle_session_response(inst, hdr, size, num_packets);
+	if (rc)
+		goto exit;
+
+	/* firmware is consuming commands, queue what was held back */
+	rc = msm_vidc_queue_held_buffers(inst);
 	if (rc)
 		goto exit;
 
@@ -2013,22 +2025,35 @@ exit:
 	return rc;
 }
 
-int handle_response(struct msm_vidc_core *core, void *response)
+int handle_response(struct msm_vidc_core *core, void *response,
+	u32 response_size)
 {
 	struct hfi_header *hdr;
+	u32 size, num_packets, session_id;
 	int rc = 0;
 
+	/* fetch the header once, see next_hfi_packet() */
 	hdr = (struct hfi_header *)response;
-	rc = validate_hdr_packet(core, hdr, __func__);
+	size = READ_ONCE(hdr->size);
+	num_packets = READ_ONCE(hdr->num_packets);
+	session_id = READ_ONCE(hdr->session_id);
+	if (size > response_size) {
+		d_vpr_e("%s: hdr size %u exceeds msg size %u\n",
+			__func__, size, response_size);
+		return handle_system_error(core, NULL);
+	}
+
+	rc = validate_hdr_packet(core, hdr, size, num_packets, __func__);
 	if (rc) {
 		d_vpr_e("%s: hdr pkt validation failed\n", __func__);
 		return handle_system_error(core, NULL);
 	}
 
-	if (!hdr->session_id)
-		return handle_system_response(core, hdr);
+	if (!session_id)
+		return handle_system_response(core, hdr, size, num_packets);
 	else
-		return handle_session_response(core, hdr);
+		return handle_session_response(core, hdr, session_id,
+					       size, num_packets);
 
 	return 0;
 }